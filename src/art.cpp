@@ -0,0 +1,469 @@
+#include "art.h"
+#include "epoch.hpp"
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+ART::ART() : root(nullptr) {
+}
+
+CompressedTrieNode *ART::find(uint8_t c) const {
+    ArtNode *r = readShared(root);
+    if (!r) return nullptr;
+
+    switch (r->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) r;
+            for (int i = 0; i < n->count; i++)
+                if (n->keys[i] == c) return readShared(n->kids[i]);
+            return nullptr;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) r;
+#ifdef __SSE2__
+            // compare all 16 keys at once, mask off the unused tail
+            __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char) c),
+                                         _mm_loadu_si128((const __m128i *) n->keys));
+            unsigned mask = _mm_movemask_epi8(cmp) & ((1u << n->count) - 1);
+            return mask ? readShared(n->kids[__builtin_ctz(mask)]) : nullptr;
+#else
+            for (int i = 0; i < n->count; i++)
+                if (n->keys[i] == c) return readShared(n->kids[i]);
+            return nullptr;
+#endif
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) r;
+            uint8_t slot = readShared(n->index[c]);
+            return slot ? readShared(n->kids[slot - 1]) : nullptr;
+        }
+        case ART_NODE256:
+            return readShared(((ArtNode256 *) r)->kids[c]);
+    }
+    return nullptr;
+}
+
+CompressedTrieNode *ART::next(int after) const {
+    if (!root) return nullptr;
+
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) root;
+            for (int i = 0; i < n->count; i++)
+                if (n->keys[i] > after) return n->kids[i];
+            return nullptr;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            for (int i = 0; i < n->count; i++)
+                if (n->keys[i] > after) return n->kids[i];
+            return nullptr;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            for (int c = after + 1; c < 256; c++)
+                if (n->index[c]) return n->kids[n->index[c] - 1];
+            return nullptr;
+        }
+        case ART_NODE256: {
+            auto n = (ArtNode256 *) root;
+            for (int c = after + 1; c < 256; c++)
+                if (n->kids[c]) return n->kids[c];
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// inserts into a sorted key array with room for one more entry
+static void sortedInsert(uint8_t *keys, int32_t *counts, CompressedTrieNode **kids,
+                         int count, uint8_t c, CompressedTrieNode *child, int childCount) {
+    int pos = 0;
+    while (pos < count && keys[pos] < c)
+        pos++;
+    memmove(keys + pos + 1, keys + pos, count - pos);
+    memmove(counts + pos + 1, counts + pos, (count - pos) * sizeof(*counts));
+    memmove(kids + pos + 1, kids + pos, (count - pos) * sizeof(*kids));
+    keys[pos] = c;
+    counts[pos] = childCount;
+    kids[pos] = child;
+}
+
+// tree[k - 1] holds the counts of bytes [k - lowbit(k), k)
+static void fenwickAdd(int32_t *tree, uint8_t c, int delta) {
+    for (int k = c + 1; k <= 256; k += k & -k)
+        tree[k - 1] += delta;
+}
+
+// first byte whose prefix sum reaches remaining, 256 if the total is less
+static int fenwickDescend(const int32_t *tree, int &remaining) {
+    int pos = 0;
+    for (int step = 256; step; step >>= 1) {
+        if (pos + step <= 256 && tree[pos + step - 1] < remaining) {
+            pos += step;
+            remaining -= tree[pos - 1];
+        }
+    }
+    return pos;
+}
+
+static int fenwickPoint(const int32_t *tree, uint8_t c) {
+    int sum = 0;
+    for (int k = c + 1; k > 0; k -= k & -k)
+        sum += tree[k - 1];
+    for (int k = c; k > 0; k -= k & -k)
+        sum -= tree[k - 1];
+    return sum;
+}
+
+// removes slot pos from a sorted key array
+static void sortedErase(uint8_t *keys, int32_t *counts, CompressedTrieNode **kids,
+                        int count, int pos) {
+    memmove(keys + pos, keys + pos + 1, count - pos - 1);
+    memmove(counts + pos, counts + pos + 1, (count - pos - 1) * sizeof(*counts));
+    memmove(kids + pos, kids + pos + 1, (count - pos - 1) * sizeof(*kids));
+}
+
+static int slotOf(const uint8_t *keys, int count, uint8_t c) {
+    for (int i = 0; i < count; i++)
+        if (keys[i] == c) return i;
+    return -1;
+}
+
+// a copy of n readers don't see yet
+template<typename T>
+static T *copyOf(T *n, Pool<T> &pool) {
+    T *copy = pool.make();
+    *copy = *n;
+    return copy;
+}
+
+void ART::insert(uint8_t c, CompressedTrieNode *child, int count, ArtPools &pools) {
+    if (!root) {
+        auto n = pools.node4.make();
+        n->type = ART_NODE4;
+        n->count = 1;
+        n->keys[0] = c;
+        n->counts[0] = count;
+        n->kids[0] = child;
+        publish(root, (ArtNode *) n);
+        return;
+    }
+
+    grow(pools);
+
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = copyOf((ArtNode4 *) root, pools.node4);
+            sortedInsert(n->keys, n->counts, n->kids, n->count, c, child, count);
+            n->count++;
+            pools.retire(root);
+            publish(root, (ArtNode *) n);
+            break;
+        }
+        case ART_NODE16: {
+            auto n = copyOf((ArtNode16 *) root, pools.node16);
+            sortedInsert(n->keys, n->counts, n->kids, n->count, c, child, count);
+            n->count++;
+            pools.retire(root);
+            publish(root, (ArtNode *) n);
+            break;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            n->kids[n->count] = child;
+            fenwickAdd(n->tree, c, count);
+            publish(n->index[c], (uint8_t) (n->count + 1));
+            n->count++;
+            break;
+        }
+        case ART_NODE256: {
+            auto n = (ArtNode256 *) root;
+            fenwickAdd(n->tree, c, count);
+            publish(n->kids[c], child);
+            n->count++;
+            break;
+        }
+    }
+}
+
+void ART::addCount(uint8_t c, int delta) {
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) root;
+            n->counts[slotOf(n->keys, n->count, c)] += delta;
+            break;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            n->counts[slotOf(n->keys, n->count, c)] += delta;
+            break;
+        }
+        case ART_NODE48:
+            fenwickAdd(((ArtNode48 *) root)->tree, c, delta);
+            break;
+        case ART_NODE256:
+            fenwickAdd(((ArtNode256 *) root)->tree, c, delta);
+            break;
+    }
+}
+
+CompressedTrieNode *ART::rank(int &remaining) const {
+    if (!root) return nullptr;
+
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) root;
+            for (int i = 0; i < n->count; i++) {
+                if (n->counts[i] >= remaining) return n->kids[i];
+                remaining -= n->counts[i];
+            }
+            return nullptr;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            for (int i = 0; i < n->count; i++) {
+                if (n->counts[i] >= remaining) return n->kids[i];
+                remaining -= n->counts[i];
+            }
+            return nullptr;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            int c = fenwickDescend(n->tree, remaining);
+            return c < 256 ? n->kids[n->index[c] - 1] : nullptr;
+        }
+        case ART_NODE256: {
+            auto n = (ArtNode256 *) root;
+            int c = fenwickDescend(n->tree, remaining);
+            return c < 256 ? n->kids[c] : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+void ART::replace(uint8_t c, CompressedTrieNode *child) {
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) root;
+            publish(n->kids[slotOf(n->keys, n->count, c)], child);
+            break;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            publish(n->kids[slotOf(n->keys, n->count, c)], child);
+            break;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            publish(n->kids[n->index[c] - 1], child);
+            break;
+        }
+        case ART_NODE256:
+            publish(((ArtNode256 *) root)->kids[c], child);
+            break;
+    }
+}
+
+void ART::erase(uint8_t c, ArtPools &pools) {
+    if (root->count == 1) {
+        clear(pools);
+        return;
+    }
+
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = copyOf((ArtNode4 *) root, pools.node4);
+            sortedErase(n->keys, n->counts, n->kids, n->count, slotOf(n->keys, n->count, c));
+            n->count--;
+            pools.retire(root);
+            publish(root, (ArtNode *) n);
+            break;
+        }
+        case ART_NODE16: {
+            auto n = copyOf((ArtNode16 *) root, pools.node16);
+            sortedErase(n->keys, n->counts, n->kids, n->count, slotOf(n->keys, n->count, c));
+            n->count--;
+            pools.retire(root);
+            publish(root, (ArtNode *) n);
+            break;
+        }
+        case ART_NODE48: {
+            // moving the last slot into the freed one in place could make
+            // a reader follow a stale index, so the kids are repacked into
+            // a copy
+            auto n = (ArtNode48 *) root, copy = pools.node48.make();
+            copy->type = ART_NODE48;
+            memcpy(copy->tree, n->tree, sizeof(n->tree));
+            fenwickAdd(copy->tree, c, -fenwickPoint(copy->tree, c));
+            int i = 0;
+            for (int k = 0; k < 256; k++) {
+                if (n->index[k] && k != c) {
+                    copy->index[k] = i + 1;
+                    copy->kids[i++] = n->kids[n->index[k] - 1];
+                }
+            }
+            copy->count = i;
+            pools.retire(root);
+            publish(root, (ArtNode *) copy);
+            break;
+        }
+        case ART_NODE256: {
+            auto n = (ArtNode256 *) root;
+            fenwickAdd(n->tree, c, -fenwickPoint(n->tree, c));
+            publish(n->kids[c], (CompressedTrieNode *) nullptr);
+            n->count--;
+            break;
+        }
+    }
+    shrink(pools);
+}
+
+int ART::size() const {
+    return root ? root->count : 0;
+}
+
+// replaces a full node with the next larger type
+void ART::grow(ArtPools &pools) {
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) root;
+            if (n->count < 4) return;
+            auto bigger = pools.node16.make();
+            bigger->type = ART_NODE16;
+            bigger->count = n->count;
+            memcpy(bigger->keys, n->keys, sizeof(n->keys));
+            memcpy(bigger->counts, n->counts, sizeof(n->counts));
+            memcpy(bigger->kids, n->kids, sizeof(n->kids));
+            pools.retire(n);
+            publish(root, (ArtNode *) bigger);
+            break;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            if (n->count < 16) return;
+            auto bigger = pools.node48.make();
+            bigger->type = ART_NODE48;
+            bigger->count = n->count;
+            for (int i = 0; i < n->count; i++) {
+                bigger->index[n->keys[i]] = i + 1;
+                bigger->kids[i] = n->kids[i];
+                fenwickAdd(bigger->tree, n->keys[i], n->counts[i]);
+            }
+            pools.retire(n);
+            publish(root, (ArtNode *) bigger);
+            break;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            if (n->count < 48) return;
+            auto bigger = pools.node256.make();
+            bigger->type = ART_NODE256;
+            bigger->count = n->count;
+            for (int c = 0; c < 256; c++)
+                if (n->index[c])
+                    bigger->kids[c] = n->kids[n->index[c] - 1];
+            memcpy(bigger->tree, n->tree, sizeof(n->tree));
+            pools.retire(n);
+            publish(root, (ArtNode *) bigger);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// replaces a node that has become mostly empty with the next smaller type,
+// thresholds sit below the grow points so alternating insert/erase doesn't
+// flip types back and forth
+void ART::shrink(ArtPools &pools) {
+    switch (root->type) {
+        case ART_NODE4:
+            if (root->count == 0)
+                clear(pools);
+            break;
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            if (n->count > 3) return;
+            auto smaller = pools.node4.make();
+            smaller->type = ART_NODE4;
+            smaller->count = n->count;
+            memcpy(smaller->keys, n->keys, n->count);
+            memcpy(smaller->counts, n->counts, n->count * sizeof(*n->counts));
+            memcpy(smaller->kids, n->kids, n->count * sizeof(*n->kids));
+            pools.retire(n);
+            publish(root, (ArtNode *) smaller);
+            break;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            if (n->count > 12) return;
+            auto smaller = pools.node16.make();
+            smaller->type = ART_NODE16;
+            int i = 0;
+            for (int c = 0; c < 256; c++) {
+                if (n->index[c]) {
+                    smaller->keys[i] = c;
+                    smaller->counts[i] = fenwickPoint(n->tree, c);
+                    smaller->kids[i] = n->kids[n->index[c] - 1];
+                    i++;
+                }
+            }
+            smaller->count = i;
+            pools.retire(n);
+            publish(root, (ArtNode *) smaller);
+            break;
+        }
+        case ART_NODE256: {
+            auto n = (ArtNode256 *) root;
+            if (n->count > 40) return;
+            auto smaller = pools.node48.make();
+            smaller->type = ART_NODE48;
+            int i = 0;
+            for (int c = 0; c < 256; c++) {
+                if (n->kids[c]) {
+                    smaller->index[c] = i + 1;
+                    smaller->kids[i] = n->kids[c];
+                    i++;
+                }
+            }
+            smaller->count = i;
+            memcpy(smaller->tree, n->tree, sizeof(n->tree));
+            pools.retire(n);
+            publish(root, (ArtNode *) smaller);
+            break;
+        }
+    }
+}
+
+void ART::clear(ArtPools &pools) {
+    if (!root) return;
+    pools.retire(root);
+    publish(root, (ArtNode *) nullptr);
+}
+
+void ArtPools::retire(ArtNode *n) {
+    switch (n->type) {
+        case ART_NODE4:
+            node4.retire((ArtNode4 *) n);
+            break;
+        case ART_NODE16:
+            node16.retire((ArtNode16 *) n);
+            break;
+        case ART_NODE48:
+            node48.retire((ArtNode48 *) n);
+            break;
+        case ART_NODE256:
+            node256.retire((ArtNode256 *) n);
+            break;
+    }
+}
+
+void ArtPools::age() {
+    node4.age();
+    node16.age();
+    node48.age();
+    node256.age();
+}
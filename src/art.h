@@ -0,0 +1,148 @@
+#ifndef art_h
+#define art_h
+
+#include "pool.hpp"
+#include <cstdint>
+
+struct CompressedTrieNode;
+
+// Adaptive radix child containers, keyed by the first byte of the child's
+// edge label. A node starts as ArtNode4 and is replaced by the next larger
+// type when full. Iteration is always in ascending byte order.
+//
+// Every container also keeps the num_leafs of each child, so rank queries
+// never have to touch the children they skip: ArtNode4/16 store them in a
+// small array beside the keys, ArtNode48/256 in a Fenwick tree over the
+// key byte, which answers prefix sums and rank descents in 8 steps.
+enum ArtType : uint8_t { ART_NODE4, ART_NODE16, ART_NODE48, ART_NODE256 };
+
+struct ArtNode {
+    uint8_t type;
+    uint16_t count;
+};
+
+// keys sorted, kids[i] and counts[i] belong to keys[i]
+struct ArtNode4 : ArtNode {
+    uint8_t keys[4];
+    int32_t counts[4];
+    CompressedTrieNode *kids[4];
+};
+
+struct ArtNode16 : ArtNode {
+    uint8_t keys[16];
+    int32_t counts[16];
+    CompressedTrieNode *kids[16];
+};
+
+// index[c] is 1 + the slot of c in kids, 0 if absent
+struct ArtNode48 : ArtNode {
+    uint8_t index[256];
+    int32_t tree[256];
+    CompressedTrieNode *kids[48];
+};
+
+struct ArtNode256 : ArtNode {
+    int32_t tree[256];
+    CompressedTrieNode *kids[256];
+};
+
+struct ArtPools {
+    Pool<ArtNode4> node4;
+    Pool<ArtNode16> node16;
+    Pool<ArtNode48> node48;
+    Pool<ArtNode256> node256;
+
+    // hands n to the retire() of the pool of its type
+    void retire(ArtNode *n);
+
+    void age();
+};
+
+// Containers are taken from and returned to the owning trie's ArtPools,
+// so an ART never frees anything on its own.
+//
+// find() may run concurrently with one writer. Sorted ArtNode4/16 are never
+// changed once visible, inserts and erases build a copy and swap root; an
+// ArtNode48 fills a fresh slot before pointing index at it and is copied on
+// erase, ArtNode256 slots are single stores. Containers that were replaced
+// are retired, not released.
+class ART {
+public:
+    ArtNode *root;
+
+    ART();
+
+    ART(const ART &) = delete;
+
+    ART &operator=(const ART &) = delete;
+
+    CompressedTrieNode *find(uint8_t c) const;
+
+    // child with the smallest key above after (-1 for the first child)
+    CompressedTrieNode *next(int after) const;
+
+    // c must not be present yet, count is the child's num_leafs
+    void insert(uint8_t c, CompressedTrieNode *child, int count, ArtPools &pools);
+
+    // points the existing slot for c at child, in one store
+    void replace(uint8_t c, CompressedTrieNode *child);
+
+    // removes c, shrinking to a smaller type once it is mostly empty
+    void erase(uint8_t c, ArtPools &pools);
+
+    int size() const;
+
+    // adds delta to the leaf count kept for child c
+    void addCount(uint8_t c, int delta);
+
+    // child whose subtree holds the remaining-th leaf below this node,
+    // with remaining reduced by the leafs of the children before it
+    CompressedTrieNode *rank(int &remaining) const;
+
+    // calls f(child) in ascending key order until it returns true,
+    // returns whether it stopped early
+    template<typename F>
+    bool forEach(F f) const;
+
+    void clear(ArtPools &pools);
+
+private:
+    void grow(ArtPools &pools);
+
+    void shrink(ArtPools &pools);
+};
+
+template<typename F>
+bool ART::forEach(F f) const {
+    if (!root) return false;
+
+    switch (root->type) {
+        case ART_NODE4: {
+            auto n = (ArtNode4 *) root;
+            for (int i = 0; i < n->count; i++)
+                if (f(n->kids[i])) return true;
+            break;
+        }
+        case ART_NODE16: {
+            auto n = (ArtNode16 *) root;
+            for (int i = 0; i < n->count; i++)
+                if (f(n->kids[i])) return true;
+            break;
+        }
+        case ART_NODE48: {
+            auto n = (ArtNode48 *) root;
+            for (int c = 0; c < 256; c++)
+                if (n->index[c] && f(n->kids[n->index[c] - 1])) return true;
+            break;
+        }
+        case ART_NODE256: {
+            auto n = (ArtNode256 *) root;
+            for (int c = 0; c < 256; c++)
+                if (n->kids[c] && f(n->kids[c])) return true;
+            break;
+        }
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef background_h
+#define background_h
+
+#include <functional>
+#include <pthread.h>
+#include <time.h>
+
+// Calls a function every intervalMs milliseconds on its own thread until
+// stopped.
+class BackgroundTask {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+    std::function<void()> fn;
+    int intervalMs;
+    bool running, stopping;
+
+    static void *loop(void *arg) {
+        auto self = (BackgroundTask *) arg;
+        pthread_mutex_lock(&self->mutex);
+        while (!self->stopping) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += self->intervalMs / 1000;
+            deadline.tv_nsec += (self->intervalMs % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&self->wakeup, &self->mutex, &deadline);
+            if (self->stopping)
+                break;
+
+            pthread_mutex_unlock(&self->mutex);
+            self->fn();
+            pthread_mutex_lock(&self->mutex);
+        }
+        pthread_mutex_unlock(&self->mutex);
+        return NULL;
+    }
+
+public:
+    BackgroundTask() : intervalMs(0), running(false), stopping(false) {
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&wakeup, NULL);
+    }
+
+    BackgroundTask(const BackgroundTask &) = delete;
+
+    BackgroundTask &operator=(const BackgroundTask &) = delete;
+
+    ~BackgroundTask() {
+        stop();
+        pthread_cond_destroy(&wakeup);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void start(std::function<void()> task, int everyMs) {
+        if (running)
+            return;
+        fn = task;
+        intervalMs = everyMs;
+        stopping = false;
+        running = true;
+        pthread_create(&thread, NULL, loop, this);
+    }
+
+    // waits for a running call of fn to finish
+    void stop() {
+        if (!running)
+            return;
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_signal(&wakeup);
+        pthread_mutex_unlock(&mutex);
+        pthread_join(thread, NULL);
+        running = false;
+    }
+};
+
+#endif
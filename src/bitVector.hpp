@@ -0,0 +1,163 @@
+#ifndef bit_vector_h
+#define bit_vector_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// words per rank block, and ones (zeros) between select samples
+#define BITS_BLOCK_WORDS 8
+#define BITS_SELECT_SAMPLE 512
+
+// Append-only bit string with constant-time rank and near constant-time
+// select once build() has run. Ranks are kept per 512-bit block, so the
+// index adds about 1.5% to the bits themselves, plus one block number per
+// 512 ones and per 512 zeros to start select's search from.
+class BitVector {
+    std::vector<uint64_t> words;
+    // ones before each block, with one extra entry for the end
+    std::vector<uint64_t> blockRanks;
+    // block holding the (i * BITS_SELECT_SAMPLE)-th one, and zero
+    std::vector<uint32_t> oneSamples, zeroSamples;
+    uint64_t bits;
+
+    uint64_t zerosBefore(uint64_t block) const {
+        return block * BITS_BLOCK_WORDS * 64 - blockRanks[block];
+    }
+
+    // position of the k-th (from 0) set bit of w
+    static int selectInWord(uint64_t w, unsigned k) {
+        int pos = 0;
+        for (int width = 32; width >= 8; width /= 2) {
+            unsigned c = __builtin_popcountll(w & ((1ULL << width) - 1));
+            if (k >= c) {
+                k -= c;
+                w >>= width;
+                pos += width;
+            }
+        }
+        for (;; w >>= 1, pos++)
+            if ((w & 1) && k-- == 0)
+                return pos;
+    }
+
+    // index of the k-th one (or zero) within a block, given the block
+    template<bool one>
+    uint64_t selectFrom(uint64_t block, uint64_t k) const {
+        k -= one ? blockRanks[block] : zerosBefore(block);
+        for (uint64_t w = block * BITS_BLOCK_WORDS;; w++) {
+            uint64_t word = one ? words[w] : ~words[w];
+            unsigned c = __builtin_popcountll(word);
+            if (k < c)
+                return w * 64 + selectInWord(word, k);
+            k -= c;
+        }
+    }
+
+    // the block holding the k-th one (or zero): binary search between the
+    // samples around it
+    template<bool one>
+    uint64_t blockOf(uint64_t k) const {
+        const std::vector<uint32_t> &samples = one ? oneSamples : zeroSamples;
+        uint64_t s = k / BITS_SELECT_SAMPLE;
+        uint64_t lo = samples[s];
+        uint64_t hi = s + 1 < samples.size() ? samples[s + 1] : blockRanks.size() - 2;
+        while (lo < hi) {
+            uint64_t mid = (lo + hi + 1) / 2;
+            if ((one ? blockRanks[mid] : zerosBefore(mid)) <= k)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return lo;
+    }
+
+public:
+    BitVector() : bits(0) {}
+
+    void push(bool bit) {
+        if (bits % 64 == 0)
+            words.push_back(0);
+        if (bit)
+            words.back() |= 1ULL << (bits % 64);
+        bits++;
+    }
+
+    // builds the rank and select index, call once after the last push
+    void build() {
+        words.resize((words.size() + BITS_BLOCK_WORDS - 1) / BITS_BLOCK_WORDS * BITS_BLOCK_WORDS + BITS_BLOCK_WORDS);
+        uint64_t blocks = words.size() / BITS_BLOCK_WORDS, ones = 0;
+        blockRanks.assign(blocks + 1, 0);
+        oneSamples.clear();
+        zeroSamples.clear();
+        for (uint64_t b = 0; b < blocks; b++) {
+            blockRanks[b] = ones;
+            for (int w = 0; w < BITS_BLOCK_WORDS; w++) {
+                uint64_t first = (b * BITS_BLOCK_WORDS + w) * 64;
+                uint64_t word = words[b * BITS_BLOCK_WORDS + w];
+                // padding past the last bit counts as neither
+                uint64_t valid = first >= bits ? 0 : bits - first >= 64 ? ~0ULL : (1ULL << (bits - first)) - 1;
+                uint64_t zeros = first - ones, c = __builtin_popcountll(word);
+                uint64_t z = __builtin_popcountll(~word & valid);
+                while (oneSamples.size() * BITS_SELECT_SAMPLE < ones + c)
+                    oneSamples.push_back(b);
+                while (zeroSamples.size() * BITS_SELECT_SAMPLE < zeros + z)
+                    zeroSamples.push_back(b);
+                ones += c;
+            }
+        }
+        blockRanks[blocks] = ones;
+        words.shrink_to_fit();
+    }
+
+    uint64_t size() const {
+        return bits;
+    }
+
+    bool operator[](uint64_t i) const {
+        return words[i / 64] >> (i % 64) & 1;
+    }
+
+    // ones in [0, i)
+    uint64_t rank1(uint64_t i) const {
+        uint64_t block = i / (BITS_BLOCK_WORDS * 64), r = blockRanks[block];
+        for (uint64_t w = block * BITS_BLOCK_WORDS; w < i / 64; w++)
+            r += __builtin_popcountll(words[w]);
+        if (i % 64)
+            r += __builtin_popcountll(words[i / 64] << (64 - i % 64));
+        return r;
+    }
+
+    // position of the k-th one, counting from 0
+    uint64_t select1(uint64_t k) const {
+        return selectFrom<true>(blockOf<true>(k), k);
+    }
+
+    // position of the k-th zero, counting from 0
+    uint64_t select0(uint64_t k) const {
+        return selectFrom<false>(blockOf<false>(k), k);
+    }
+
+    // first one at or after i, which must exist
+    uint64_t nextOne(uint64_t i) const {
+        uint64_t w = i / 64, word = words[w] >> (i % 64) << (i % 64);
+        while (!word)
+            word = words[++w];
+        return w * 64 + __builtin_ctzll(word);
+    }
+
+    // first zero at or after i, which must exist
+    uint64_t nextZero(uint64_t i) const {
+        uint64_t w = i / 64, word = ~words[w] >> (i % 64) << (i % 64);
+        while (!word)
+            word = ~words[++w];
+        return w * 64 + __builtin_ctzll(word);
+    }
+
+    size_t bytes() const {
+        return words.capacity() * sizeof(uint64_t) + blockRanks.capacity() * sizeof(uint64_t) +
+               (oneSamples.capacity() + zeroSamples.capacity()) * sizeof(uint32_t);
+    }
+};
+
+#endif
@@ -1,67 +1,274 @@
 #include "ctrie.hpp"
-#include "util.hpp"
 #include<cassert>
+#include <algorithm>
+#include <cstring>
+#include <thread>
 
 using namespace std;
 
-CompressedTrie::CompressedTrie() {
-    root = new CompressedTrieNode();
+// writes between attempts to advance the epoch, each scans every reader slot
+#ifndef EPOCH_WRITES
+#define EPOCH_WRITES 64
+#endif
+
+CompressedTrie::CompressedTrie(uint64_t max_entries, bool hugePages) : prefixes(nullptr), writes(0), stale(false) {
+    arena = new TrieArena();
+    reserve(max_entries, hugePages);
+    root = arena->nodes.make();
+    root->parent = nullptr;
+}
+
+// every node, value and child container lives in the arena slabs
+CompressedTrie::~CompressedTrie() {
+    delete prefixes;
+    prefixes = nullptr;
+    delete arena;
+    arena = nullptr;
+    root = nullptr;
+}
+
+TrieArena *CompressedTrie::clear() {
+    // two epochs on, whoever entered before is gone
+    for (int i = 0; i < 2; i++)
+        while (!epochs.advance())
+            this_thread::yield();
+
+    bool indexed = prefixes, hugePages = arena->nodes.hugePages;
+    delete prefixes;
+    prefixes = nullptr;
+    TrieArena *old = arena;
+    arena = new TrieArena();
+    reserve(0, hugePages);
+    root = arena->nodes.make();
     root->parent = nullptr;
+    writes = 0;
+    unsettled.clear();
+    stale = false;
+    if (indexed)
+        enablePrefixIndex();
+    return old;
+}
+
+void CompressedTrie::reserve(uint64_t max_entries, bool hugePages) {
+    arena->nodes.hugePages = hugePages;
+    arena->art.node4.hugePages = arena->art.node16.hugePages = hugePages;
+    arena->art.node48.hugePages = arena->art.node256.hugePages = hugePages;
+
+    // a compressed trie over n keys has at most 2n nodes, half of them inner
+    arena->nodes.reserve(2 * max_entries);
+    arena->art.node4.reserve(max_entries);
+}
+
+static LogRef copyLabel(TrieArena *arena, CompressedTrieNode *node, const char *label, int size) {
+    node->edgeKey = label[0];
+#ifdef PACKED_LABELS
+    char packed[256];
+    packLabel(label, size, packed);
+    label = packed;
+#endif
+    arena->labelChars += size;
+    return arena->log.append(node, LOG_LABEL, label, labelBytes(size));
+}
+
+// node is being unlinked or replaced
+static void releaseLabel(TrieArena *arena, CompressedTrieNode *node) {
+    arena->labelChars -= node->edgeLabelSize;
+    arena->log.release(node->edgelabel);
+}
+
+static void setValue(TrieArena *arena, CompressedTrieNode *node, const Slice &value) {
+    LogRef old = node->value;
+    publish(node->value, arena->log.append(node, LOG_VALUE, value.data, value.size));
+    arena->log.release(old);
+}
+
+// hands the value record of from, which is about to be retired, over to to;
+// readers still in from keep seeing it
+static void moveValue(TrieArena *arena, CompressedTrieNode *from, CompressedTrieNode *to) {
+    to->value = from->value;
+    if (to->value)
+        arena->log.header(to->value)->owner = to;
+}
+
+void updateChildren(CompressedTrieNode *node) {
+    node->sucs.forEach([node](CompressedTrieNode *kid) {
+        kid->parent = node;
+        return false;
+    });
+}
+
+void CompressedTrie::touch(CompressedTrieNode *node, int delta) {
+    node->pending += delta;
+    if (!node->queued) {
+        node->queued = true;
+        unsettled.push_back(node);
+    }
+    stale = true;
+}
+
+void CompressedTrie::handOver(CompressedTrieNode *from, CompressedTrieNode *to) {
+    // its queue entry goes stale, settle() skips it
+    from->queued = false;
+    if (from->pending)
+        touch(to, from->pending);
+    from->pending = 0;
 }
 
-void updateChildren(BSTNode *r, CompressedTrieNode *val) {
-    if (!r) return;
-    updateChildren(r->left, val);
-    updateChildren(r->right, val);
-    r->data->parent = val;
+void CompressedTrie::settle() const {
+    // readers sharing the trie check the flag without the lock; clearing
+    // it last publishes the counts
+    if (!readShared(stale))
+        return;
+    lock_guard<mutex> hold(settling);
+    if (!stale)
+        return;
+    for (size_t i = 0; i < unsettled.size(); i++) {
+        CompressedTrieNode *node = unsettled[i], *parent = node->parent;
+        if (!node->queued)
+            continue;
+        node->queued = false;
+        int delta = node->pending;
+        node->pending = 0;
+        if (!delta)
+            continue;
+        INSTRUMENTED(counters.settleSteps++;)
+        node->num_leafs += delta;
+        if (!parent)
+            continue;
+        parent->sucs.addCount(node->edgeKey, delta);
+        parent->pending += delta;
+        if (!parent->queued) {
+            parent->queued = true;
+            unsettled.push_back(parent);
+        }
+    }
+    unsettled.clear();
+    publish(stale, false);
 }
 
-void inc(CompressedTrieNode *curr_node, const int &val) {
-    while (curr_node) {
-        curr_node->num_leafs += val;
-        curr_node = curr_node->parent;
+void sortBatch(const Slice *keys, int *order, int n) {
+    // sort on the first 8 bytes read once per key (big endian, zero padded,
+    // so integer order is byte order) and only compare whole keys on ties
+    vector<pair<uint64_t, int>> heads(n);
+    for (int k = 0; k < n; k++) {
+        const Slice &key = keys[order[k]];
+        uint64_t head = 0;
+        for (int b = 0; b < 8; b++)
+            head = head << 8 | (b < key.size ? (uint8_t) key.data[b] : 0);
+        heads[k] = {head, order[k]};
     }
+    sort(heads.begin(), heads.end(), [keys](const pair<uint64_t, int> &a, const pair<uint64_t, int> &b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        const Slice &x = keys[a.second], &y = keys[b.second];
+        int cmp = memcmp(x.data, y.data, min(x.size, y.size));
+        if (cmp || x.size != y.size)
+            return cmp ? cmp < 0 : x.size < y.size;
+        return a.second < b.second;
+    });
+
+    for (int k = 0; k < n; k++)
+        order[k] = heads[k].second;
+}
+
+void sortBatch(const Slice *keys, int n, vector<int> &order) {
+    order.resize(n);
+    for (int k = 0; k < n; k++)
+        order[k] = k;
+    sortBatch(keys, order.data(), n);
+}
+
+// positions node/i/j inside the deepest node that key shares with the
+// finger's previous key, returns false if the walk has to start at root
+static bool resume(const TrieFinger *finger, const Slice &key, CompressedTrieNode *&node, int &i, int &j) {
+    if (!finger || !finger->node)
+        return false;
+
+    // keep at least one character to match so callers' loops run
+    int limit = min(min(finger->matched, finger->size), key.size - 1), common = 0;
+    while (common < limit && finger->key[common] == key.data[common])
+        common++;
+
+    // climb to the node holding key depth common - 1
+    node = finger->node;
+    int start = finger->start;
+    while (node->parent && start >= common) {
+        node = node->parent;
+        start -= node->edgeLabelSize;
+    }
+    if (!node->parent)
+        return false;
+
+    i = min(common, start + node->edgeLabelSize);
+    j = i - start;
+    return true;
+}
+
+// the key of this operation ends inside node
+static void mark(TrieFinger *finger, const Slice &key, CompressedTrieNode *node, int start, int matched) {
+    if (!finger)
+        return;
+    finger->key = key.data;
+    finger->size = key.size;
+    finger->node = node;
+    finger->start = start;
+    finger->matched = matched;
 }
 
-bool CompressedTrie::insert(const Slice &key, const Slice &value) {
+// tells the prefix index (if any) that node now spans key depths
+// [start, start + edgeLabelSize); path holds at least start key characters
+void CompressedTrie::cover(CompressedTrieNode *node, int start, const char *path) {
+    char scratch[256];
+    if (prefixes)
+        prefixes->cover(node, start, node->edgeLabelSize, path, labelOf(arena->log, node, scratch));
+}
+
+bool CompressedTrie::insert(const Slice &key, const Slice &value, TrieFinger *finger) {
     char *keyPointer = key.data;
 
     if (key.size == 0)
         return false;
-    // No matching edge present, just insert entire word
-    BSTNode *bstnode = root->sucs.search(*keyPointer);
+    if (++writes >= EPOCH_WRITES)
+        collect();
 
-    if (!bstnode) {
-        bstnode = root->sucs.getOrInsert(*keyPointer);
-        bstnode->data = new CompressedTrieNode();
+    int i = 0, j = 0;
+    CompressedTrieNode *curr_node = nullptr;
 
-        CompressedTrieNode *curr_node = bstnode->data;
-        curr_node->edgelabel = keyPointer;
+    if (resume(finger, key, curr_node, i, j)) {
+        keyPointer += i;
+    }
+    // resume right after the first four characters if they are indexed
+    else if (prefixes && key.size > PREFIX_LEN && prefixes->find(key.data, curr_node, j) && curr_node) {
+        i = PREFIX_LEN;
+        keyPointer += PREFIX_LEN;
+    } else {
+        j = 0;
+        curr_node = root->sucs.find(*keyPointer);
+    }
+
+    // No matching edge present, just insert entire word
+    if (!curr_node) {
+        curr_node = arena->nodes.make();
+        curr_node->edgelabel = copyLabel(arena, curr_node, keyPointer, key.size);
         curr_node->edgeLabelSize = key.size;
         curr_node->isLeaf = true;
         curr_node->parent = root;
+        setValue(arena, curr_node, value);
+        root->sucs.insert(*keyPointer, curr_node, 0, arena->art);
+        cover(curr_node, 0, key.data);
 
-        curr_node->value = new Slice(value.data, value.size);
-        inc(curr_node, 1);
+        touch(curr_node, 1);
+        mark(finger, key, curr_node, 0, key.size);
         return false;
     } else {
-        int i = 0, j = 0;
-        auto bstnode = root->sucs.getOrInsert(*keyPointer);
-        auto curr_node = bstnode->data;
-
         while (i < key.size) {
-            char *word_to_cmp = curr_node->edgelabel;
+            char *word_to_cmp = arena->log.at(curr_node->edgelabel);
             int wtcSize = curr_node->edgeLabelSize;
-            char *wtc = word_to_cmp;
-
-            j = 0;
-            while (i < key.size && j < wtcSize &&
-                   *keyPointer == *wtc) {
-                i++;
-                keyPointer++;
-                j++;
-                wtc++;
-            }
+
+            int m = labelMatch(word_to_cmp, j, keyPointer, min(key.size - i, wtcSize - j));
+            i += m;
+            keyPointer += m;
+            j += m;
             // i complete
             if (i == key.size) {
                 // j also complete - mark this as leaf node
@@ -69,38 +276,23 @@ bool CompressedTrie::insert(const Slice &key, const Slice &value) {
                     bool should = false;
                     if (curr_node->isLeaf)
                         should = true;
-                    curr_node->isLeaf = true;
-                    curr_node->value = new Slice(value.data, value.size);
-                    inc(curr_node, !should);
+                    // the value first, readers check isLeaf before reading it
+                    setValue(arena, curr_node, value);
+                    publish(curr_node->isLeaf, true);
+                    if (!should)
+                        touch(curr_node, 1);
+                    mark(finger, key, curr_node, i - j, i);
                     return should;
                 }
                     // j remaining - split word into 2
                 else {
-                    char *rem_word = wtc;
-                    auto *newnode = new CompressedTrieNode();
-                    newnode->edgelabel = rem_word;
-                    newnode->edgeLabelSize = wtcSize - j;
-                    newnode->isLeaf = curr_node->isLeaf;
-                    newnode->parent = curr_node;
-                    newnode->num_leafs = curr_node->num_leafs;
-                    if (curr_node->isLeaf) {
-                        newnode->value = curr_node->value;
-                    }
-
-                    newnode->sucs.root = curr_node->sucs.root;
-
-                    updateChildren(newnode->sucs.getRoot(), newnode);
-
-                    curr_node->edgelabel = word_to_cmp;
-                    curr_node->edgeLabelSize = j;
-
-                    curr_node->isLeaf = true;
-                    curr_node->sucs.root = nullptr;
-
-                    curr_node->sucs.getOrInsert(rem_word[0])->data = newnode;
-
-                    curr_node->value = new Slice(value.data, value.size);
-                    inc(curr_node, 1);
+                    // the node for the first j bytes holds the key
+                    CompressedTrieNode *top = split(curr_node, j, i - j, key.data);
+                    top->isLeaf = true;
+                    setValue(arena, top, value);
+                    swap(curr_node, top);
+                    touch(top, 1);
+                    mark(finger, key, top, i - j, i);
                     return false;
 
                 }
@@ -108,196 +300,489 @@ bool CompressedTrie::insert(const Slice &key, const Slice &value) {
                 // i not complete, j complete
             else if (j == wtcSize) {
                 // no remaining edge
-                if (!curr_node->sucs.search(*keyPointer)) {
+                CompressedTrieNode *next = curr_node->sucs.find(*keyPointer);
+                if (!next) {
                     CompressedTrieNode *curr_parent = curr_node;
 
-                    auto node = curr_node->sucs.getOrInsert(*keyPointer);
-                    node->data = new CompressedTrieNode();
-
-                    curr_node = node->data;
-                    curr_node->edgelabel = keyPointer;
+                    curr_node = arena->nodes.make();
+                    curr_node->edgelabel = copyLabel(arena, curr_node, keyPointer, key.size - i);
                     curr_node->edgeLabelSize = key.size - i;
                     curr_node->isLeaf = true;
                     curr_node->parent = curr_parent;
-                    i = key.size;
-                    curr_node->value = new Slice(value.data, value.size);
-                    inc(curr_node, 1);
-
+                    setValue(arena, curr_node, value);
+                    curr_parent->sucs.insert(*keyPointer, curr_node, 0, arena->art);
+                    cover(curr_node, i, key.data);
+                    touch(curr_node, 1);
+                    mark(finger, key, curr_node, i, key.size);
+                    return false;
                 } else {
-                    // remaining edge - continue with matching
-                    // curr_node = curr_node->children[word[i]];
-                    bstnode = curr_node->sucs.getOrInsert(*keyPointer);
-                    curr_node = bstnode->data;
+                    // remaining edge - continue with matching, fetching the
+                    // child container while the label is compared
+                    curr_node = next;
+                    __builtin_prefetch(next->sucs.root);
+                    j = 0;
                 }
             }
                 // i not complete & j not complete. Split into two and insert
             else {
                 char *rem_word_i = keyPointer; // word.substr(i);
-                char *rem_word_j = wtc; // word_to_cmp.substr(j);
-                char *match_word = word_to_cmp; // word_to_cmp.substr(0, j);
+                CompressedTrieNode *top = split(curr_node, j, i - j, key.data);
 
-                auto *newnode = new CompressedTrieNode();
+                auto *newnode2 = arena->nodes.make();
+                newnode2->isLeaf = true;
+                newnode2->edgelabel = copyLabel(arena, newnode2, rem_word_i, key.size - i);
+                newnode2->edgeLabelSize = key.size - i;
+                newnode2->parent = top;
+                setValue(arena, newnode2, value);
+                cover(newnode2, i, key.data);
+                top->sucs.insert(*rem_word_i, newnode2, 0, arena->art);
 
-                newnode->isLeaf = curr_node->isLeaf;
-                newnode->num_leafs = curr_node->num_leafs;
-                if (curr_node->isLeaf) {
-                    newnode->value = curr_node->value;
-                }
+                swap(curr_node, top);
+                touch(newnode2, 1);
+                mark(finger, key, newnode2, i, key.size);
 
-                newnode->sucs.root = curr_node->sucs.root;
-                curr_node->sucs.root = nullptr;
-                newnode->edgelabel = rem_word_j;
-                newnode->edgeLabelSize = wtcSize - j;
-                newnode->parent = curr_node;
-                updateChildren(newnode->sucs.getRoot(), newnode);
+                return false;
+            }
+        }
+    }
 
-                auto *newnode2 = new CompressedTrieNode();
-                newnode2->isLeaf = true;
-                newnode2->num_leafs++;
-                newnode2->edgelabel = rem_word_i;
-                newnode2->edgeLabelSize = key.size - i;
-                newnode2->parent = curr_node;
-                newnode2->value = new Slice(value.data, value.size);
+    return true;
+}
 
-                curr_node->isLeaf = false;
-                curr_node->edgelabel = match_word;
-                curr_node->edgeLabelSize = j;
+CompressedTrieNode *CompressedTrie::split(CompressedTrieNode *node, int j, int start, const char *path) {
+    ValueLog &log = arena->log;
+    char scratch[256];
+    const char *label = labelOf(log, node, scratch);
+    INSTRUMENTED(counters.splits++;)
 
-                curr_node->sucs.root = nullptr;
-                curr_node->sucs.getOrInsert(rem_word_j[0])->data =
-                        newnode;
+    auto *top = arena->nodes.make();
+    top->edgelabel = copyLabel(arena, top, label, j);
+    top->edgeLabelSize = j;
+    top->num_leafs = node->num_leafs;
+    top->parent = node->parent;
 
-                auto node = curr_node->sucs.getOrInsert(*rem_word_i);
-                node->data = newnode2;
+    auto *bottom = arena->nodes.make();
+    bottom->edgelabel = copyLabel(arena, bottom, label + j, node->edgeLabelSize - j);
+    bottom->edgeLabelSize = node->edgeLabelSize - j;
+    bottom->isLeaf = node->isLeaf;
+    bottom->num_leafs = node->num_leafs;
+    handOver(node, bottom);
+    bottom->parent = top;
+    moveValue(arena, node, bottom);
+    // the container is shared with node until node is retired
+    bottom->sucs.root = node->sucs.root;
+    updateChildren(bottom);
+    top->sucs.insert(bottom->edgeKey, bottom, bottom->num_leafs, arena->art);
+    releaseLabel(arena, node);
 
-                inc(curr_node, 1);
+    cover(top, start, path);
+    cover(bottom, start + j, path);
+    return top;
+}
 
-                return false;
+void CompressedTrie::swap(CompressedTrieNode *node, CompressedTrieNode *fresh) {
+    node->parent->sucs.replace(node->edgeKey, fresh);
+    arena->nodes.retire(node);
+}
+
+void CompressedTrie::collect() {
+    writes = 0;
+    if (!epochs.advance())
+        return;
+    arena->nodes.age();
+    arena->art.age();
+}
+
+int CompressedTrie::bulkLoad(const Slice *keys, const Slice *values, const int *order, int n) {
+    // the path from root to the previous key, innermost last. Nodes get
+    // their label and are counted into their parent once popped, when every
+    // key below them is known; until then start/end are key depths.
+    struct Open {
+        CompressedTrieNode *node;
+        int start, end;
+    };
+    // readers may be walking root meanwhile, so the keys go under a
+    // detached node whose children are handed to root once complete
+    CompressedTrieNode *top = arena->nodes.make();
+    vector<Open> path(1, Open{top, 0, 0});
+    const Slice *prev = nullptr;
+    int loaded = 0, rest = n;
+    const int ahead = 16;
+
+    auto close = [&]() {
+        Open &top = path.back();
+        CompressedTrieNode *node = top.node, *parent = node->parent;
+        node->edgelabel = copyLabel(arena, node, prev->data + top.start, top.end - top.start);
+        node->edgeLabelSize = top.end - top.start;
+        cover(node, top.start, prev->data);
+        parent->num_leafs += node->num_leafs;
+        parent->sucs.addCount(node->edgeKey, node->num_leafs);
+        path.pop_back();
+    };
+
+    for (int k = 0; k < n; k++) {
+        // through order every key is a cache miss, fetch them ahead
+        if (order && k + 2 * ahead < n) {
+            __builtin_prefetch(&keys[order[k + 2 * ahead]]);
+            __builtin_prefetch(&values[order[k + 2 * ahead]]);
+        }
+        if (order && k + ahead < n)
+            __builtin_prefetch(keys[order[k + ahead]].data);
+        const Slice &key = keys[order ? order[k] : k];
+        if (key.size == 0)
+            continue;
+
+        int lcp = 0;
+        if (prev) {
+            lcp = matchLength(prev->data, key.data, min(prev->size, key.size));
+            // a repeated key overwrites the value of the previous one
+            if (lcp == prev->size && lcp == key.size) {
+                setValue(arena, path.back().node, values[order ? order[k] : k]);
+                prev = &key;
+                continue;
+            }
+            // out of order after all: what came before is a valid trie,
+            // the keys from here on are inserted one by one below
+            if (lcp == key.size || (lcp < prev->size && (uint8_t) key.data[lcp] < (uint8_t) prev->data[lcp])) {
+                rest = k;
+                break;
             }
         }
+
+        while (path.back().end > lcp) {
+            Open &top = path.back();
+            if (top.start >= lcp) {
+                close();
+                continue;
+            }
+            // key leaves top's label at lcp: split off the shared part
+            // as a new inner node, top keeps the rest below it
+            CompressedTrieNode *shared = arena->nodes.make();
+            CompressedTrieNode *parent = top.node->parent;
+            shared->edgeKey = top.node->edgeKey;
+            shared->parent = parent;
+            parent->sucs.replace(shared->edgeKey, shared);
+            top.node->edgeKey = prev->data[lcp];
+            top.node->parent = shared;
+            shared->sucs.insert(top.node->edgeKey, top.node, 0, arena->art);
+            path.insert(path.end() - 1, Open{shared, top.start, lcp});
+            path.back().start = lcp;
+        }
+
+        CompressedTrieNode *leaf = arena->nodes.make(), *parent = path.back().node;
+        leaf->edgeKey = key.data[lcp];
+        leaf->parent = parent;
+        leaf->isLeaf = true;
+        leaf->num_leafs = 1;
+        setValue(arena, leaf, values[order ? order[k] : k]);
+        parent->sucs.insert(leaf->edgeKey, leaf, 0, arena->art);
+        path.push_back(Open{leaf, lcp, key.size});
+        prev = &key;
+        loaded++;
     }
 
-    return true;
+    while (path.size() > 1)
+        close();
+
+    root->sucs.clear(arena->art);
+    top->sucs.forEach([this](CompressedTrieNode *kid) {
+        kid->parent = root;
+        return false;
+    });
+    root->num_leafs += top->num_leafs;
+    publish(root->sucs.root, top->sucs.root);
+    arena->nodes.release(top);
+
+    for (int k = rest; k < n; k++) {
+        const Slice &key = keys[order ? order[k] : k];
+        if (key.size && !insert(key, values[order ? order[k] : k]))
+            loaded++;
+    }
+    return loaded;
 }
 
-bool searchKidsHelper(BSTNode *r, char *keyPointer, int keySize, Slice &A, Slice &B, int &remaining, char *kOrg) {
-    if (!r) return false;
+static void coverAll(PrefixIndex *index, ValueLog &log, CompressedTrieNode *node, int start, char *path);
 
-    if (searchKidsHelper(r->left, keyPointer, keySize, A, B, remaining, kOrg)) return true;
+// adds shift to every log ref below node, after its records moved logs
+static void rebase(CompressedTrieNode *node, LogRef shift) {
+    vector<CompressedTrieNode *> stack(1, node);
+    while (!stack.empty()) {
+        node = stack.back();
+        stack.pop_back();
+        node->edgelabel += shift;
+        if (node->value)
+            node->value += shift;
+        node->sucs.forEach([&stack](CompressedTrieNode *kid) {
+            stack.push_back(kid);
+            return false;
+        });
+    }
+}
 
-    auto trieNode = r->data;
+int CompressedTrie::parallelLoad(const Slice *keys, const Slice *values, int n, bool sorted, int threads) {
+    // stable counting sort by leading byte, empty keys are dropped
+    vector<int> start(257, 0);
+    for (int k = 0; k < n; k++)
+        if (keys[k].size)
+            start[(uint8_t) keys[k].data[0] + 1]++;
+    for (int c = 0; c < 256; c++)
+        start[c + 1] += start[c];
+    int total = start[256];
+    vector<int> order(total), next(start.begin(), start.end() - 1);
+    for (int k = 0; k < n; k++)
+        if (keys[k].size)
+            order[next[(uint8_t) keys[k].data[0]]++] = k;
 
-    if (trieNode->num_leafs < remaining) {
-        remaining -= trieNode->num_leafs;
-        return searchKidsHelper(r->right, keyPointer, keySize, A, B, remaining, kOrg);
+    // cut the byte range into runs of about total / threads keys
+    vector<int> cuts(1, 0);
+    for (int c = 1; c < 256; c++) {
+        if ((int) cuts.size() < threads && start[c] - start[cuts.back()] >= total / threads)
+            cuts.push_back(c);
     }
+    cuts.push_back(256);
 
-    // edge label loop
-    char *edger = trieNode->edgelabel;
-    for (int i = 0; i < trieNode->edgeLabelSize; i++) {
-        *keyPointer = *edger;
-        keyPointer++;
-        edger++;
-        keySize++;
+    int runs = cuts.size() - 1;
+    vector<CompressedTrie *> parts(runs);
+    vector<int> loaded(runs);
+    vector<thread> workers;
+    for (int r = 0; r < runs; r++) {
+        workers.emplace_back([&, r] {
+            int *run = order.data() + start[cuts[r]], len = start[cuts[r + 1]] - start[cuts[r]];
+            if (!sorted)
+                sortBatch(keys, run, len);
+            parts[r] = new CompressedTrie(len, arena->nodes.hugePages);
+            loaded[r] = parts[r]->bulkLoad(keys, values, run, len);
+            // a mis-sorted run leaves the counts of its inserts pending
+            parts[r]->settle();
+        });
     }
+    for (auto &w : workers)
+        w.join();
 
-    if (trieNode->isLeaf)
-        remaining--;
+    // adopt every part's arena, then fix up their log refs in parallel
+    vector<LogRef> shift(runs);
+    for (int r = 0; r < runs; r++) {
+        TrieArena *from = parts[r]->arena;
+        shift[r] = arena->log.absorb(from->log);
+        arena->nodes.absorb(from->nodes);
+        arena->art.node4.absorb(from->art.node4);
+        arena->art.node16.absorb(from->art.node16);
+        arena->art.node48.absorb(from->art.node48);
+        arena->art.node256.absorb(from->art.node256);
+        arena->labelChars += from->labelChars;
+    }
+    workers.clear();
+    for (int r = 0; r < runs; r++) {
+        workers.emplace_back([&, r] {
+            parts[r]->root->sucs.forEach([&](CompressedTrieNode *kid) {
+                rebase(kid, shift[r]);
+                return false;
+            });
+        });
+    }
+    for (auto &w : workers)
+        w.join();
 
-    if (remaining == 0) {
-        A.data = kOrg;
-        A.size = keySize;
-        B.data = trieNode->value->data;
-        B.size = trieNode->value->size;
-        return true;
+    // runs cover disjoint leading bytes, so their top nodes go straight
+    // under root
+    int sum = 0;
+    for (int r = 0; r < runs; r++) {
+        CompressedTrieNode *top = parts[r]->root;
+        top->sucs.forEach([this](CompressedTrieNode *kid) {
+            kid->parent = root;
+            root->sucs.insert(kid->edgeKey, kid, kid->num_leafs, arena->art);
+            return false;
+        });
+        root->num_leafs += top->num_leafs;
+        top->sucs.clear(arena->art);
+        arena->nodes.release(top);
+        parts[r]->root = nullptr;
+        delete parts[r];
+        sum += loaded[r];
     }
 
-    return searchKidsHelper(trieNode->sucs.getRoot(), keyPointer, keySize, A, B, remaining, kOrg);
+    if (prefixes) {
+        char path[PREFIX_LEN];
+        coverAll(prefixes, arena->log, root, 0, path);
+    }
+    return sum;
 }
 
 bool CompressedTrie::search(const int &N, Slice &A, Slice &B) {
-    int left = N;
+    int remaining = N;
+    if (remaining < 1)
+        return false;
+    settle();
 
     char *keyPointer = (char *) malloc(65), *kOrg = keyPointer;
     int keySize = 0;
+    CompressedTrieNode *trieNode = root;
 
-    return searchKidsHelper(root->sucs.getRoot(), keyPointer, keySize, A, B, left, kOrg);
-}
+    // one rank step per level, appending each edge label to the key
+    while ((trieNode = trieNode->sucs.rank(remaining))) {
+        readLabel(arena->log, trieNode, keyPointer);
+        keyPointer += trieNode->edgeLabelSize;
+        keySize += trieNode->edgeLabelSize;
 
-bool delKidsHelper(BSTNode *r, int &remaining) {
-    if (!r) return false;
+        if (trieNode->isLeaf && --remaining == 0) {
+            A.data = kOrg;
+            A.size = keySize;
+            B.data = arena->log.at(trieNode->value);
+            B.size = arena->log.header(trieNode->value)->size;
+            return true;
+        }
+    }
 
-    if (delKidsHelper(r->left, remaining)) return true;
+    free(kOrg);
+    return false;
+}
 
-    auto trieNode = r->data;
+bool CompressedTrie::del(const int &N) {
+    int remaining = N;
+    if (remaining < 1)
+        return false;
+    if (++writes >= EPOCH_WRITES)
+        collect();
+    settle();
 
-    if (trieNode->num_leafs < remaining) {
-        remaining -= trieNode->num_leafs;
-        return delKidsHelper(r->right, remaining);
+    // erase() needs the key prefix to keep the prefix index up to date
+    char path[256];
+    int depth = 0;
+    CompressedTrieNode *trieNode = root;
+    while ((trieNode = trieNode->sucs.rank(remaining))) {
+        if (trieNode->isLeaf && --remaining == 0) {
+            erase(trieNode, depth, path);
+            return true;
+        }
+        readLabel(arena->log, trieNode, path + depth);
+        depth += trieNode->edgeLabelSize;
     }
 
-    if (trieNode->isLeaf)
-        remaining--;
+    return false;
+}
 
-    if (remaining == 0) {
-        bool should = trieNode->isLeaf;
-        trieNode->isLeaf = false;
-        resetPointer(trieNode->value);
-        trieNode->value = nullptr;
-        inc(trieNode, should ? -1 : 0);
-        return true;
-    }
+CompressedTrieNode *CompressedTrie::erase(CompressedTrieNode *node, int &start, const char *path) {
+    ValueLog &log = arena->log;
+    publish(node->isLeaf, false);
+    log.release(node->value);
+    publish(node->value, (LogRef) 0);
+    touch(node, -1);
+
+    if (node == root || node->sucs.size() > 1)
+        return node;
+
+    if (node->sucs.size() == 1)
+        return merge(node, start, path);
+
+    // no value and no children left: unlink the node
+    CompressedTrieNode *parent = node->parent;
+    parent->sucs.erase(node->edgeKey, arena->art);
+    handOver(node, parent);
+    char scratch[256];
+    if (prefixes)
+        prefixes->uncover(node, start, node->edgeLabelSize, path, labelOf(log, node, scratch));
+    releaseLabel(arena, node);
+    arena->nodes.retire(node);
 
-    return delKidsHelper(trieNode->sucs.getRoot(), remaining);
+    // the parent may now be a pass-through node
+    start -= parent->edgeLabelSize;
+    if (parent != root && !parent->isLeaf && parent->sucs.size() == 1)
+        return merge(parent, start, path);
+    return parent;
 }
 
-bool CompressedTrie::del(const int &N) {
-    int left = N;
+CompressedTrieNode *CompressedTrie::merge(CompressedTrieNode *node, int start, const char *path) {
+    ValueLog &log = arena->log;
+    CompressedTrieNode *child = nullptr;
+    node->sucs.forEach([&child](CompressedTrieNode *kid) {
+        child = kid;
+        return true;
+    });
+
+    char label[256];
+    int size = node->edgeLabelSize + child->edgeLabelSize;
+    readLabel(log, node, label);
+    readLabel(log, child, label + node->edgeLabelSize);
 
-    return delKidsHelper(root->sucs.getRoot(), left);
+    // num_leafs and the parent's count for node are unchanged
+    INSTRUMENTED(counters.merges++;)
+    auto *merged = arena->nodes.make();
+    merged->edgelabel = copyLabel(arena, merged, label, size);
+    merged->edgeLabelSize = size;
+    merged->isLeaf = child->isLeaf;
+    merged->num_leafs = node->num_leafs;
+    handOver(node, merged);
+    handOver(child, merged);
+    merged->parent = node->parent;
+    moveValue(arena, child, merged);
+    merged->sucs.root = child->sucs.root;
+    updateChildren(merged);
+    releaseLabel(arena, node);
+    releaseLabel(arena, child);
+
+    // merged now covers whatever depths node and child covered
+    cover(merged, start, path);
+    swap(node, merged);
+    // readers still in node need its container until it is reused
+    arena->art.retire(node->sucs.root);
+    arena->nodes.retire(child);
+    return merged;
 }
 
-bool CompressedTrie::searchDelWrapper(const Slice &key, Slice &value, enum types type) const {
+bool CompressedTrie::searchDelWrapper(const Slice &key, Slice &value, enum types type, TrieFinger *finger) {
     int i = 0, j = 0;
     char *keyPointer = key.data;
+    CompressedTrieNode *curr_node;
 
     if (key.size == 0)
         return false;
 
-    if (!root->sucs.search(*keyPointer))
+    // searches may run next to a writer (see the class comment), so
+    // whatever it changes in place is loaded once with readShared
+    PrefixIndex *index = readShared(prefixes);
+    if (resume(finger, key, curr_node, i, j)) {
+        keyPointer += i;
+    } else if (index && key.size > PREFIX_LEN && index->find(key.data, curr_node, j)) {
+        i = PREFIX_LEN;
+        keyPointer += PREFIX_LEN;
+    } else {
+        curr_node = root->sucs.find(*keyPointer);
+    }
+    if (!curr_node) {
+        mark(finger, key, nullptr, 0, 0);
         return false;
+    }
 
     bool ispresent = false;
-    BSTNode *bstnode = root->sucs.getOrInsert(*keyPointer);
-    CompressedTrieNode *curr_node = bstnode->data;
 
     while (i < key.size) {
-        j = 0;
-
-        char *word_to_match = curr_node->edgelabel;
-        char *wtc = word_to_match;
+        char *word_to_match = arena->log.at(readShared(curr_node->edgelabel));
         int wtcSize = curr_node->edgeLabelSize;
 
-        while (i < key.size && j < wtcSize &&
-               *keyPointer == *wtc) {
-            i++;
-            keyPointer++;
-            wtc++;
-            j++;
-        }
+        int m = labelMatch(word_to_match, j, keyPointer, min(key.size - i, wtcSize - j));
+        i += m;
+        keyPointer += m;
+        j += m;
         // completed matching
         if (i == key.size) {
-            ispresent = j == wtcSize && curr_node->isLeaf;
+            ispresent = j == wtcSize && readShared(curr_node->isLeaf);
             if (ispresent) {
                 if (type == IS_SEARCH) {
-                    value.size = curr_node->value->size;
-                    value.data = curr_node->value->data;
+                    // a concurrent del clears isLeaf before value
+                    LogRef ref = readShared(curr_node->value);
+                    ispresent = ref != 0;
+                    if (ispresent) {
+                        value.size = arena->log.header(ref)->size;
+                        value.data = arena->log.at(ref);
+                    }
                 } else if (type == IS_DEL) {
-                    bool should = curr_node->isLeaf;
-                    curr_node->isLeaf = false;
-                    resetPointer(curr_node->value);
-                    curr_node->value = nullptr;
-                    inc(curr_node, should ? -1 : 0);
+                    int start = i - j, erased = start;
+                    curr_node = erase(curr_node, start, key.data);
+                    // the erased node's label may be unlinked and its
+                    // parent merged with a sibling, so only the key
+                    // characters above it are still known to be on the path
+                    mark(finger, key, curr_node, start, erased);
+                    return true;
                 } else {
                     assert(false); // not implemented
                 }
@@ -307,14 +792,16 @@ bool CompressedTrie::searchDelWrapper(const Slice &key, Slice &value, enum types
         else {
             // j completed
             if (j == wtcSize) {
-                auto bstnode = curr_node->sucs.search(*keyPointer);
+                auto next = curr_node->sucs.find(*keyPointer);
                 // nowhere to go
-                if (!bstnode) {
+                if (!next) {
                     ispresent = false;
                     break;
                 } else {
                     // continue matching
-                    curr_node = bstnode->data;
+                    curr_node = next;
+                    __builtin_prefetch(readShared(next->sucs.root));
+                    j = 0;
                 }
             }
                 // j remaining, no match
@@ -324,15 +811,364 @@ bool CompressedTrie::searchDelWrapper(const Slice &key, Slice &value, enum types
             }
         }
     }
+    mark(finger, key, curr_node, i - j, i);
     return ispresent;
 }
 
-bool CompressedTrie::search(const Slice &key, Slice &value) const {
-    return searchDelWrapper(key, value, IS_SEARCH);
+bool CompressedTrie::search(const Slice &key, Slice &value, TrieFinger *finger) {
+    return searchDelWrapper(key, value, IS_SEARCH, finger);
 }
 
-bool CompressedTrie::del(const Slice &key) {
+#ifndef BATCH_LANES
+#define BATCH_LANES 16
+#endif
+
+// Each round first prefetches the label and child container of every lane's
+// current node, then advances every lane by one node and prefetches the node
+// it moves to. Finished lanes pick up the next key of the batch.
+void CompressedTrie::searchBatch(const Slice *keys, const int *order, int n, Slice *values, bool *found) {
+    struct Lane {
+        int idx;
+        CompressedTrieNode *node;
+        int i, j;
+    };
+    ValueLog &log = arena->log;
+    PrefixIndex *index = readShared(prefixes);
+    Lane lanes[BATCH_LANES];
+    int active = 0, next = 0;
+
+    // positions a lane on the first node of keys[idx], false if that
+    // already decides the key
+    auto begin = [&](Lane &lane, int idx) {
+        const Slice &key = keys[idx];
+        if (found)
+            found[idx] = false;
+        lane = {idx, nullptr, 0, 0};
+        if (key.size == 0)
+            return false;
+        if (index && key.size > PREFIX_LEN && index->find(key.data, lane.node, lane.j))
+            lane.i = PREFIX_LEN;
+        else
+            lane.node = root->sucs.find(key.data[0]);
+        if (!lane.node)
+            return false;
+        __builtin_prefetch(lane.node);
+        return true;
+    };
+
+    // matches one edge label, false once the key is decided
+    auto step = [&](Lane &lane) {
+        const Slice &key = keys[lane.idx];
+        CompressedTrieNode *node = lane.node;
+        char *label = log.at(readShared(node->edgelabel));
+        int m = labelMatch(label, lane.j, key.data + lane.i, min(key.size - lane.i, node->edgeLabelSize - lane.j));
+        lane.i += m;
+        lane.j += m;
+        if (lane.i == key.size) {
+            LogRef ref;
+            if (found && lane.j == node->edgeLabelSize && readShared(node->isLeaf) &&
+                (ref = readShared(node->value))) {
+                found[lane.idx] = true;
+                values[lane.idx].size = log.header(ref)->size;
+                values[lane.idx].data = log.at(ref);
+            }
+            return false;
+        }
+        if (lane.j < node->edgeLabelSize || !(lane.node = node->sucs.find(key.data[lane.i])))
+            return false;
+        lane.j = 0;
+        __builtin_prefetch(lane.node);
+        return true;
+    };
+
+    while (active < BATCH_LANES && next < n) {
+        if (begin(lanes[active], order ? order[next] : next))
+            active++;
+        next++;
+    }
+
+    while (active) {
+        for (int k = 0; k < active; k++) {
+            __builtin_prefetch(log.at(readShared(lanes[k].node->edgelabel)));
+            __builtin_prefetch(readShared(lanes[k].node->sucs.root));
+        }
+        for (int k = 0; k < active;) {
+            if (step(lanes[k])) {
+                k++;
+                continue;
+            }
+            // refill the lane, or close the gap with the last one, which
+            // hasn't been stepped this round yet
+            bool refilled = false;
+            while (!refilled && next < n) {
+                refilled = begin(lanes[k], order ? order[next] : next);
+                next++;
+            }
+            if (refilled)
+                k++;
+            else
+                lanes[k] = lanes[--active];
+        }
+    }
+}
+
+bool CompressedTrie::del(const Slice &key, TrieFinger *finger) {
+    if (++writes >= EPOCH_WRITES)
+        collect();
     Slice value{};
-    return searchDelWrapper(key, value, IS_DEL);
+    return searchDelWrapper(key, value, IS_DEL, finger);
+}
+
+
+bool CompressedTrie::compact() {
+    ValueLog &log = arena->log;
+    int seg = log.victim();
+    if (seg < 0)
+        return false;
+
+    // a record is live only while its owner still points at it
+    log.forEachRecord(seg, [&](LogRef ref, LogRecord *rec) {
+        CompressedTrieNode *owner = rec->owner;
+        if (!owner)
+            return;
+        if (rec->kind == LOG_LABEL && owner->edgelabel == ref)
+            publish(owner->edgelabel, log.append(owner, LOG_LABEL, log.at(ref), rec->size));
+        else if (rec->kind == LOG_VALUE && owner->value == ref)
+            publish(owner->value, log.append(owner, LOG_VALUE, log.at(ref), rec->size));
+    });
+    log.drop(seg, epochs.current());
+    return true;
 }
 
+void TrieStats::add(const TrieStats &other) {
+    entries += other.entries;
+    nodes += other.nodes;
+    for (int t = 0; t < 4; t++)
+        containers[t] += other.containers[t];
+    retired += other.retired;
+    labelChars += other.labelChars;
+    nodeBytes += other.nodeBytes;
+    containerBytes += other.containerBytes;
+    logBytes += other.logBytes;
+    liveLogBytes += other.liveLogBytes;
+    garbageLogBytes += other.garbageLogBytes;
+    prefixIndexBytes += other.prefixIndexBytes;
+
+    walked = walked && other.walked;
+    deadNodes += other.deadNodes;
+    if (depths.size() < other.depths.size())
+        depths.resize(other.depths.size());
+    for (size_t d = 0; d < other.depths.size(); d++)
+        depths[d] += other.depths[d];
+    if (fanouts.size() < other.fanouts.size())
+        fanouts.resize(other.fanouts.size());
+    for (size_t c = 0; c < other.fanouts.size(); c++)
+        fanouts[c] += other.fanouts[c];
+    for (int t = 0; t < 4; t++)
+        walkedContainers[t] += other.walkedContainers[t];
+    walkedLabelChars += other.walkedLabelChars;
+}
+
+// labels are at least one character, so depth stays below 256
+static void walkStats(const CompressedTrieNode *node, int depth, TrieStats &s) {
+    int kids = node->sucs.size();
+    s.fanouts[kids]++;
+    if (node->sucs.root)
+        s.walkedContainers[node->sucs.root->type]++;
+    s.walkedLabelChars += node->edgeLabelSize;
+    if (node->isLeaf) {
+        if (s.depths.size() <= (size_t) depth)
+            s.depths.resize(depth + 1);
+        s.depths[depth]++;
+    } else if (!kids && depth > 0) {
+        s.deadNodes++;
+    }
+    node->sucs.forEach([&](CompressedTrieNode *kid) {
+        walkStats(kid, depth + 1, s);
+        return false;
+    });
+}
+
+TrieStats CompressedTrie::stats(bool walk) const {
+    TrieStats s;
+    const ArtPools &art = arena->art;
+    s.entries = size();
+    s.nodes = arena->nodes.liveObjects() - arena->nodes.retiredObjects();
+    s.containers[0] = art.node4.liveObjects() - art.node4.retiredObjects();
+    s.containers[1] = art.node16.liveObjects() - art.node16.retiredObjects();
+    s.containers[2] = art.node48.liveObjects() - art.node48.retiredObjects();
+    s.containers[3] = art.node256.liveObjects() - art.node256.retiredObjects();
+    s.retired = arena->nodes.retiredObjects() + art.node4.retiredObjects() + art.node16.retiredObjects() +
+                art.node48.retiredObjects() + art.node256.retiredObjects();
+    s.labelChars = arena->labelChars;
+    s.nodeBytes = arena->nodes.reservedBytes();
+    s.containerBytes = art.node4.reservedBytes() + art.node16.reservedBytes() + art.node48.reservedBytes() +
+                       art.node256.reservedBytes();
+    s.logBytes = arena->log.reservedBytes();
+    s.liveLogBytes = arena->log.liveBytes();
+    s.garbageLogBytes = arena->log.garbageBytes();
+    s.prefixIndexBytes = prefixes ? (uint64_t) PREFIX_SLOTS * sizeof(uintptr_t) : 0;
+
+    if (walk) {
+        s.walked = true;
+        s.fanouts.assign(257, 0);
+        walkStats(root, 0, s);
+    }
+    return s;
+}
+
+// fills index with every node that already covers depth 3
+static void coverAll(PrefixIndex *index, ValueLog &log, CompressedTrieNode *node, int start, char *path) {
+    node->sucs.forEach([&](CompressedTrieNode *kid) {
+        char scratch[256];
+        const char *label = labelOf(log, kid, scratch);
+        index->cover(kid, start, kid->edgeLabelSize, path, label);
+        if (start + kid->edgeLabelSize < PREFIX_LEN) {
+            memcpy(path + start, label, kid->edgeLabelSize);
+            coverAll(index, log, kid, start + kid->edgeLabelSize, path);
+        }
+        return false;
+    });
+}
+
+void CompressedTrie::enablePrefixIndex() {
+    if (prefixes)
+        return;
+    // readers take a missing entry for a missing prefix, so the index
+    // is only published once complete
+    auto *index = new PrefixIndex();
+    char path[PREFIX_LEN];
+    coverAll(index, arena->log, root, 0, path);
+    publish(prefixes, index);
+}
+
+TrieCursor::TrieCursor(CompressedTrie *T, char *buffer)
+        : T(T), buffer(buffer), depth(0), floor(1) {}
+
+void TrieCursor::push(CompressedTrieNode *node) {
+    readLabel(T->arena->log, node, buffer + depth);
+    depth += node->edgeLabelSize;
+    path.push_back(node);
+}
+
+void TrieCursor::pop() {
+    depth -= path.back()->edgeLabelSize;
+    path.pop_back();
+}
+
+// descends to the smallest key at or below the top of the path
+bool TrieCursor::first() {
+    while (!path.back()->isLeaf) {
+        CompressedTrieNode *kid = path.back()->sucs.next(-1);
+        if (!kid) {
+            // only an empty root has neither
+            path.resize(1);
+            return false;
+        }
+        push(kid);
+    }
+    return true;
+}
+
+// moves to the smallest key after the whole subtree at the top of the path
+bool TrieCursor::skip() {
+    while (path.size() > floor) {
+        CompressedTrieNode *done = path.back();
+        pop();
+        CompressedTrieNode *sibling = path.back()->sucs.next(done->edgeKey);
+        if (sibling) {
+            push(sibling);
+            return first();
+        }
+    }
+    path.resize(1);
+    return false;
+}
+
+bool TrieCursor::seek(const Slice &key) {
+    path.assign(1, T->root);
+    depth = 0;
+    floor = 1;
+
+    while (depth < key.size) {
+        CompressedTrieNode *node = path.back();
+        uint8_t c = key.data[depth];
+        CompressedTrieNode *kid = node->sucs.find(c);
+        if (!kid) {
+            // everything below node sorts before key except the children
+            // after c
+            kid = node->sucs.next(c);
+            if (!kid)
+                return skip();
+            push(kid);
+            return first();
+        }
+
+        char scratch[256];
+        const char *label = labelOf(T->arena->log, kid, scratch);
+        int m = matchLength(label, key.data + depth, min(kid->edgeLabelSize, key.size - depth));
+        int at = depth;
+        push(kid);
+        if (m == kid->edgeLabelSize)
+            continue;
+        // key ends inside the label or the label sorts after key
+        if (at + m == key.size || (uint8_t) label[m] > (uint8_t) key.data[at + m])
+            return first();
+        return skip();
+    }
+    return first();
+}
+
+bool TrieCursor::seek(int N) {
+    path.assign(1, T->root);
+    depth = 0;
+    floor = 1;
+    if (N < 1)
+        return false;
+    T->settle();
+
+    CompressedTrieNode *node;
+    while ((node = path.back()->sucs.rank(N))) {
+        push(node);
+        if (node->isLeaf && --N == 0)
+            return true;
+    }
+    path.resize(1);
+    return false;
+}
+
+bool TrieCursor::prefixScan(const Slice &prefix) {
+    path.assign(1, T->root);
+    depth = 0;
+    floor = 1;
+
+    while (depth < prefix.size) {
+        CompressedTrieNode *kid = path.back()->sucs.find(prefix.data[depth]);
+        if (!kid) {
+            path.resize(1);
+            return false;
+        }
+        char scratch[256];
+        const char *label = labelOf(T->arena->log, kid, scratch);
+        int m = matchLength(label, prefix.data + depth, min(kid->edgeLabelSize, prefix.size - depth));
+        if (m < kid->edgeLabelSize && depth + m < prefix.size) {
+            path.resize(1);
+            return false;
+        }
+        push(kid);
+    }
+    floor = path.size();
+    return first();
+}
+
+bool TrieCursor::next() {
+    if (!valid())
+        return false;
+    // a key's extensions come right after it
+    CompressedTrieNode *kid = path.back()->sucs.next(-1);
+    if (kid) {
+        push(kid);
+        return first();
+    }
+    return skip();
+}
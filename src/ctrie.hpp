@@ -1,9 +1,16 @@
 #ifndef trie_h
 #define trie_h
 
-#include "bst.h"
+#include "art.h"
+#include "epoch.hpp"
+#include "instrument.hpp"
+#include "label.hpp"
+#include "prefixIndex.hpp"
+#include "valueLog.hpp"
+#include <cstring>
 #include <iostream>
-#include <map>
+#include <mutex>
+#include <vector>
 
 using namespace std;
 
@@ -15,53 +22,342 @@ struct Slice {
     Slice(){}
 };
 
+// edgelabel and value are records in the trie's ValueLog, the label holds
+// edgeLabelSize characters in the form label.hpp describes. Once a node is linked into the
+// trie only isLeaf, value, edgelabel (moved by compaction) and the child
+// container change, each by a single store; a node whose label has to
+// change is replaced by a new one.
+//
+// A node's leaf count is num_leafs plus the pending of every node below it
+// and of itself; num_leafs always equals the count parent->sucs keeps for
+// the node. Writes only add to pending, CompressedTrie::settle() folds it
+// into the counts.
 struct CompressedTrieNode {
 public:
-    map<char, CompressedTrieNode *> children;
-    BST sucs;
-    char *edgelabel;
+    ART sucs;
+    LogRef edgelabel;
     int edgeLabelSize;
     bool isLeaf;
+    // first byte of the edge label, the node's key in parent->sucs
+    uint8_t edgeKey;
+    // in the trie's unsettled queue
+    bool queued;
     int num_leafs;
+    int pending;
     CompressedTrieNode *parent;
-    Slice *value;
+    LogRef value;
 
-    CompressedTrieNode() : num_leafs(0) {};
+    CompressedTrieNode()
+        : edgelabel(0), edgeLabelSize(0), isLeaf(false), edgeKey(0), queued(false), num_leafs(0),
+          pending(0), parent(nullptr), value(0) {};
+};
+
+// per-trie allocators for every object the trie creates
+struct TrieArena {
+    Pool<CompressedTrieNode> nodes;
+    ArtPools art;
+    ValueLog log;
+    // over the edge labels of the nodes linked into the trie
+    uint64_t labelChars = 0;
 
-    ~CompressedTrieNode() {
-        sucs.clear();
+    uint64_t reservedBytes() const {
+        return nodes.reservedBytes() + art.node4.reservedBytes() + art.node16.reservedBytes() +
+               art.node48.reservedBytes() + art.node256.reservedBytes() + log.reservedBytes();
     }
 };
 
+// What a trie holds and what that costs. Everything up to walked comes
+// from counters the writers keep, the rest is only filled in by a walk
+// over every node.
+struct TrieStats {
+    uint64_t entries = 0;
+    // linked into the trie, root included
+    uint64_t nodes = 0;
+    // in use by a node, by type: ArtNode4, 16, 48 and 256
+    uint64_t containers[4] = {};
+    // nodes and containers unlinked but not yet recycled (see Pool)
+    uint64_t retired = 0;
+    uint64_t labelChars = 0;
+    // mapped by the node and container pools, and by log segments
+    uint64_t nodeBytes = 0, containerBytes = 0, logBytes = 0;
+    // records in the log still referenced, and overwritten or deleted ones
+    // left for the compactor
+    uint64_t liveLogBytes = 0, garbageLogBytes = 0;
+    // virtual, most of it never touched
+    uint64_t prefixIndexBytes = 0;
+
+    bool walked = false;
+    // neither a key nor any children, which a consistent trie never has
+    uint64_t deadNodes = 0;
+    // depths[d] keys end d nodes below root
+    vector<uint64_t> depths;
+    // fanouts[c] nodes have c children
+    vector<uint64_t> fanouts;
+    // what the walk found of containers and labelChars, which should
+    // match the counters
+    uint64_t walkedContainers[4] = {};
+    uint64_t walkedLabelChars = 0;
+
+    double averageLabel() const {
+        return nodes > 1 ? (double) labelChars / (nodes - 1) : 0;
+    }
+
+    // children over container slots; every node but root fills one slot
+    double containerFill() const {
+        uint64_t slots = 4 * containers[0] + 16 * containers[1] + 48 * containers[2] + 256 * containers[3];
+        return slots ? (double) (nodes - 1) / slots : 0;
+    }
+
+    uint64_t bytes() const {
+        return nodeBytes + containerBytes + logBytes;
+    }
+
+    // sums another trie's statistics into these
+    void add(const TrieStats &other);
+};
+
+// node's label characters into to
+static inline void readLabel(const ValueLog &log, const CompressedTrieNode *node, char *to) {
+#ifdef PACKED_LABELS
+    unpackLabel(log.at(node->edgelabel), node->edgeLabelSize, to);
+#else
+    memcpy(to, log.at(node->edgelabel), node->edgeLabelSize);
+#endif
+}
+
+// node's label characters, decoded into scratch (256 bytes) if need be
+static inline const char *labelOf(const ValueLog &log, const CompressedTrieNode *node, char *scratch) {
+#ifdef PACKED_LABELS
+    unpackLabel(log.at(node->edgelabel), node->edgeLabelSize, scratch);
+    return scratch;
+#else
+    (void) scratch;
+    return log.at(node->edgelabel);
+#endif
+}
+
 enum types {
     IS_SEARCH, IS_DEL
 };
 
+// Where the previous key of a sorted batch ended. The next key resumes from
+// the deepest node it shares with that key instead of starting at root.
+struct TrieFinger {
+    const char *key;
+    int size;
+    // null until the first key of the batch
+    CompressedTrieNode *node;
+    // key depth at which node's edge label begins
+    int start;
+    // key characters known to match the path
+    int matched;
+
+    TrieFinger() : key(nullptr), size(0), node(nullptr), start(0), matched(0) {}
+};
+
+// indices 0..n-1 ordered by key, equal keys keep their batch order
+void sortBatch(const Slice *keys, int n, vector<int> &order);
+
+// sorts the indices order[0..n) the same way
+void sortBatch(const Slice *keys, int *order, int n);
+
+// search and searchBatch may run while another thread writes, inside an
+// EpochGuard on epochs and without any lock; everything else needs the
+// trie to itself. Writers copy a node instead of changing its label in
+// place, swap the copy into the parent's container with one pointer store,
+// and retire the old node (as well as replaced containers and compacted log
+// segments) to be reused only once no reader can still be inside it.
 class CompressedTrie {
 public:
     CompressedTrieNode *root;
+    TrieArena *arena;
+    // optional 4-character jump table, null until enablePrefixIndex()
+    PrefixIndex *prefixes;
+    EpochManager epochs;
+    // inserts and dels since the last collect()
+    unsigned writes;
+#ifdef FASTMAP_INSTRUMENT
+    mutable TrieCounters counters;
+#endif
+    // one settle() at a time
+    mutable mutex settling;
+    // nodes with pending leaf counts (and entries for nodes retired since,
+    // which are no longer queued), set while there are any
+    mutable vector<CompressedTrieNode *> unsettled;
+    mutable bool stale;
 
-    CompressedTrie();
+    explicit CompressedTrie(uint64_t max_entries = 0, bool hugePages = false);
 
-    ~CompressedTrie() {
-        if (root) {
-            free(root);
-            root = nullptr;
-        }
-    }
+    ~CompressedTrie();
+
+    CompressedTrie(const CompressedTrie &) = delete;
+
+    CompressedTrie &operator=(const CompressedTrie &) = delete;
+
+    // pre-sizes the arena slabs for max_entries keys
+    void reserve(uint64_t max_entries, bool hugePages = false);
 
-    bool insert(const Slice &key, const Slice &value);
+    // finger, if given, both steers this insert and records where it ended
+    bool insert(const Slice &key, const Slice &value, TrieFinger *finger = nullptr);
 
+    // Builds an empty trie from keys[order[0..n)] (keys[0..n) if order is
+    // null) in ascending order, in one pass without descending from root:
+    // each node is created once, where the key parts from its predecessor,
+    // and labelled and counted when the last key below it has been seen.
+    // Repeated keys keep the last value. Keys from the first one that
+    // doesn't ascend on are inserted one at a time instead, so mis-sorted
+    // input costs time, not keys. Returns how many keys it holds.
+    int bulkLoad(const Slice *keys, const Slice *values, const int *order, int n);
 
-    bool search(const Slice &key, Slice &value) const;
+    // bulkLoad for keys[0..n) in any order (or ascending if sorted is set,
+    // see bulkLoad for when they don't)
+    // on up to threads threads: keys are split by leading byte into runs of
+    // whole root subtrees, each run is sorted and loaded into a trie with
+    // its own arena on its own thread, and the results are moved under root.
+    int parallelLoad(const Slice *keys, const Slice *values, int n, bool sorted, int threads);
 
-    bool searchDelWrapper(const Slice &key, Slice &value, enum types type) const;
+    void enablePrefixIndex();
 
-    bool del(const Slice &key);
+    void cover(CompressedTrieNode *node, int start, const char *path);
+
+
+    bool search(const Slice &key, Slice &value, TrieFinger *finger = nullptr);
+
+    // looks up keys[order[0..n)] (keys[0..n) if order is null), interleaving
+    // the walks of several keys so their cache misses overlap. With values
+    // and found null it only pulls the paths into cache ahead of writes.
+    void searchBatch(const Slice *keys, const int *order, int n, Slice *values, bool *found);
+
+    bool searchDelWrapper(const Slice &key, Slice &value, enum types type, TrieFinger *finger = nullptr);
+
+    bool del(const Slice &key, TrieFinger *finger = nullptr);
 
     bool del(const int &N);
 
     bool search(const int &N, Slice &A, Slice &B);
+
+    // clears the value of node, which spans key depths starting at start, then
+    // frees it if that leaves it childless and re-compresses the chain left
+    // behind; path holds at least start key characters. Returns the deepest
+    // node of the path that survives, with start moved to its depth.
+    CompressedTrieNode *erase(CompressedTrieNode *node, int &start, const char *path);
+
+    // replaces node and its only child by one node with both labels, which
+    // is returned; start and path as for erase
+    CompressedTrieNode *merge(CompressedTrieNode *node, int start, const char *path);
+
+    // Builds the replacement for node, which spans key depths from start,
+    // when a key parts from its label after j bytes: a new node for the
+    // first j bytes above a copy of node for the rest, which takes over
+    // node's value and children. path holds at least start + j key
+    // characters. The caller finishes the returned top node and swaps it in.
+    CompressedTrieNode *split(CompressedTrieNode *node, int j, int start, const char *path);
+
+    // records that node gained (or lost) delta keys; this is all a write
+    // does for the leaf counts
+    void touch(CompressedTrieNode *node, int delta);
+
+    // moves the pending count of from, which is leaving the trie, to to
+    void handOver(CompressedTrieNode *from, CompressedTrieNode *to);
+
+    // Folds every pending count into num_leafs and the parent containers
+    // on the way to root. Queued nodes are taken in order and queue their
+    // parent in turn, so the paths of writes made since the last call are
+    // walked about once each. Rank queries and anything else reading the
+    // counts call it first; it may run while other threads read, but not
+    // next to a writer.
+    void settle() const;
+
+    // entries, settling the counts first
+    int size() const {
+        settle();
+        return root->num_leafs;
+    }
+
+    bool empty() const {
+        return root->sucs.size() == 0;
+    }
+
+    // links fresh into node's slot in its parent and retires node
+    void swap(CompressedTrieNode *node, CompressedTrieNode *fresh);
+
+    // moves the live records out of the log segment with the most garbage,
+    // returns false if no segment can be compacted
+    bool compact();
+
+    // advances the epoch if no reader is behind, recycling what was
+    // retired two epochs ago
+    void collect();
+
+    // collect(), then frees log segments emptied by earlier compactions
+    // that no reader can still be in
+    void reclaim() {
+        collect();
+        arena->log.reclaim(epochs.current() - 1);
+    }
+
+    // Empties the trie once every reader that may still be inside has left
+    // and returns the arena with everything it held, for the caller to free
+    // when slices into it are no longer used. New readers must be sent
+    // elsewhere first.
+    TrieArena *clear();
+
+    double garbageRatio() const {
+        return arena->log.garbageRatio();
+    }
+
+    // counters only unless walk is set, see TrieStats
+    TrieStats stats(bool walk = false) const;
+};
+
+// In-order walk over a trie with an explicit stack of the nodes from root
+// to the current key. The key is assembled in a caller-supplied buffer of
+// at least 256 bytes, values point into the trie's log. Any insert or del
+// on the trie invalidates the cursor.
+class TrieCursor {
+    CompressedTrie *T;
+    char *buffer;
+    int depth;
+    vector<CompressedTrieNode *> path;
+    // path never shrinks below this, prefix scans raise it to the node
+    // holding the end of the prefix
+    size_t floor;
+
+    void push(CompressedTrieNode *node);
+
+    void pop();
+
+    bool first();
+
+    bool skip();
+
+public:
+    TrieCursor(CompressedTrie *T, char *buffer);
+
+    // first key >= key
+    bool seek(const Slice &key);
+
+    // N-th key (one-indexed)
+    bool seek(int N);
+
+    // first key starting with prefix, next() stops after the last one
+    bool prefixScan(const Slice &prefix);
+
+    // moves to the following key, false (and invalid) past the last one
+    bool next();
+
+    bool valid() const {
+        return path.size() > 1;
+    }
+
+    Slice key() const {
+        return Slice(buffer, depth);
+    }
+
+    Slice value() const {
+        LogRef ref = path.back()->value;
+        return Slice(T->arena->log.at(ref), T->arena->log.header(ref)->size);
+    }
 };
 
 #endif
@@ -0,0 +1,128 @@
+#ifndef epoch_h
+#define epoch_h
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// readers that can be inside one trie at the same time without sharing a
+// slot; more still work, they probe for a free one
+#ifndef EPOCH_SLOTS
+#define EPOCH_SLOTS 64
+#endif
+
+// a field lock-free readers may load while the writer stores to it
+template<typename T>
+static inline T readShared(const T &field) {
+    return __atomic_load_n(&field, __ATOMIC_ACQUIRE);
+}
+
+// makes everything written before visible to readers that load field
+template<typename T>
+static inline void publish(T &field, T value) {
+    __atomic_store_n(&field, value, __ATOMIC_RELEASE);
+}
+
+// Epoch-based reclamation. Readers announce the global epoch in a slot of
+// their own while they walk the structure; the (single) writer retires what
+// it unlinks instead of freeing it, and may bump the epoch once every
+// reader inside has seen the current one. Anything retired in epoch e is
+// unreachable for readers entering after that, and once the epoch reaches
+// e + 2 every reader from before has left, so it can be reused.
+class EpochManager {
+    // one cache line each, so readers never write to a shared line
+    struct Slot {
+        // 0 while idle, otherwise the epoch the reader entered in
+        std::atomic<uint64_t> epoch;
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    Slot *slots;
+    std::atomic<uint64_t> global;
+
+    // spreads threads over the slots
+    static unsigned threadHint() {
+        static std::atomic<unsigned> threads(0);
+        static thread_local unsigned hint = threads++;
+        return hint;
+    }
+
+public:
+    EpochManager() : global(1) {
+        void *mem;
+        if (posix_memalign(&mem, 64, EPOCH_SLOTS * sizeof(Slot)))
+            throw std::bad_alloc();
+        slots = (Slot *) mem;
+        for (int s = 0; s < EPOCH_SLOTS; s++)
+            new(&slots[s].epoch) std::atomic<uint64_t>(0);
+    }
+
+    ~EpochManager() {
+        free(slots);
+    }
+
+    EpochManager(const EpochManager &) = delete;
+
+    EpochManager &operator=(const EpochManager &) = delete;
+
+    // returns the slot to pass to exit()
+    int enter() {
+        for (unsigned s = threadHint() % EPOCH_SLOTS;; s = (s + 1) % EPOCH_SLOTS) {
+            uint64_t idle = 0, now = global.load();
+            if (slots[s].epoch.load(std::memory_order_relaxed) != 0 ||
+                !slots[s].epoch.compare_exchange_strong(idle, now))
+                continue;
+            // the writer may have moved on before the slot was taken
+            uint64_t again;
+            while ((again = global.load()) != now) {
+                slots[s].epoch.store(again);
+                now = again;
+            }
+            return s;
+        }
+    }
+
+    void exit(int slot) {
+        slots[slot].epoch.store(0, std::memory_order_release);
+    }
+
+    uint64_t current() const {
+        return global.load(std::memory_order_relaxed);
+    }
+
+    // writer only: moves to the next epoch unless a reader is still in an
+    // older one, returns whether it did
+    bool advance() {
+        uint64_t now = global.load(std::memory_order_relaxed);
+        // pairs with the announcing exchange in enter(): either the reader
+        // is seen here or it sees everything unlinked before
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (int s = 0; s < EPOCH_SLOTS; s++) {
+            uint64_t e = slots[s].epoch.load(std::memory_order_acquire);
+            if (e && e != now)
+                return false;
+        }
+        global.store(now + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// keeps the calling thread inside the current epoch for its lifetime
+class EpochGuard {
+    EpochManager &epochs;
+    int slot;
+
+public:
+    explicit EpochGuard(EpochManager &epochs) : epochs(epochs), slot(epochs.enter()) {}
+
+    ~EpochGuard() {
+        epochs.exit(slot);
+    }
+
+    EpochGuard(const EpochGuard &) = delete;
+
+    EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+#endif
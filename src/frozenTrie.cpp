@@ -0,0 +1,127 @@
+#include "frozenTrie.hpp"
+#include <cstdlib>
+
+using namespace std;
+
+FrozenTrie::FrozenTrie(CompressedTrie &T) {
+    ValueLog &log = T.arena->log;
+    T.settle();
+
+    // breadth first, so each node's children get consecutive numbers
+    vector<CompressedTrieNode *> order(1, T.root);
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i]->sucs.forEach([&order](CompressedTrieNode *kid) {
+            order.push_back(kid);
+            return false;
+        });
+    }
+
+    keys.reserve(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        CompressedTrieNode *node = order[i];
+        for (int c = node->sucs.size(); c > 0; c--)
+            louds.push(true);
+        louds.push(false);
+        leaves.push(node->isLeaf);
+        inner.push(node->sucs.size() > 0);
+        if (node->sucs.size() > 0)
+            counts.push_back(node->num_leafs);
+        keys.push_back(node->edgeKey);
+
+        if (i > 0) {
+            labels.resize(labels.size() + node->edgeLabelSize);
+            readLabel(log, node, labels.data() + labels.size() - node->edgeLabelSize);
+            labelStarts.push(true);
+            for (int b = 1; b < node->edgeLabelSize; b++)
+                labelStarts.push(false);
+        }
+        if (node->isLeaf) {
+            const char *v = log.at(node->value);
+            uint32_t size = log.header(node->value)->size;
+            values.insert(values.end(), v, v + size + 1);
+            valueStarts.push(true);
+            for (uint32_t b = 0; b < size; b++)
+                valueStarts.push(false);
+        }
+    }
+    // so the last label and value end where the next would start
+    labelStarts.push(true);
+    valueStarts.push(true);
+
+    louds.build();
+    leaves.build();
+    inner.build();
+    counts.shrink_to_fit();
+    labelStarts.build();
+    valueStarts.build();
+    labels.shrink_to_fit();
+    values.shrink_to_fit();
+}
+
+uint64_t FrozenTrie::child(uint64_t node, uint8_t c) const {
+    uint64_t lo, end;
+    children(node, lo, end);
+    uint64_t hi = end;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (keys[mid] < c)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < end && keys[lo] == c ? lo : 0;
+}
+
+bool FrozenTrie::search(const Slice &key, Slice &value) const {
+    uint64_t node = 0;
+    int i = 0;
+    while (i < key.size) {
+        node = child(node, key.data[i]);
+        if (!node)
+            return false;
+        int size;
+        const char *l = label(node, size);
+        if (size > key.size - i || memcmp(l, key.data + i, size))
+            return false;
+        i += size;
+    }
+    if (!leaves[node])
+        return false;
+    value = this->value(node);
+    return true;
+}
+
+bool FrozenTrie::search(int N, Slice &key, Slice &value) const {
+    if (N < 1 || N > size())
+        return false;
+
+    char *buffer = (char *) malloc(256);
+    int depth = 0;
+    uint64_t node = 0;
+    while (true) {
+        // the child whose subtree holds the N-th leaf; the counts of
+        // siblings with children are consecutive too, a childless one
+        // holds just its own key
+        uint64_t kid, end;
+        children(node, kid, end);
+        const uint32_t *count = counts.data() + inner.rank1(kid);
+        while (true) {
+            int below = inner[kid] ? *count++ : 1;
+            if (N <= below)
+                break;
+            N -= below;
+            kid++;
+        }
+        int size;
+        const char *l = label(kid, size);
+        memcpy(buffer + depth, l, size);
+        depth += size;
+        if (leaves[kid] && --N == 0) {
+            key.data = buffer;
+            key.size = depth;
+            value = this->value(kid);
+            return true;
+        }
+        node = kid;
+    }
+}
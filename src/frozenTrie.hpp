@@ -0,0 +1,128 @@
+#ifndef frozen_trie_h
+#define frozen_trie_h
+
+#include "bitVector.hpp"
+#include "ctrie.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Immutable succinct copy of a CompressedTrie. Nodes are numbered breadth
+// first (root is 0) and exist only as positions in a few bit strings:
+//
+//   louds        for every node, a one per child and then a zero; the k-th
+//                one stands for node k + 1, so the children of a node are
+//                consecutive and found with one select
+//   leaves       bit i is set if node i holds a value
+//   inner        bit i is set if node i has children; the keys below the
+//                k-th such node are counted in counts[k]
+//   keys         first label byte of every node, binary searched when
+//                picking a child
+//   labels       labels of nodes 1..n-1 back to back, labelStarts marking
+//                where each begins
+//   values       values of the leaves in node order, NUL terminated like in
+//                the log, valueStarts marking where each begins
+//
+// That is a few bits per node, and a count per inner node, on top of the
+// label and value bytes, against a node, a child container and two log
+// record headers in the trie. The price is a rank or select per step of a
+// lookup where the trie follows a pointer.
+class FrozenTrie {
+    BitVector louds, leaves, inner, labelStarts, valueStarts;
+    std::vector<uint8_t> keys;
+    std::vector<uint32_t> counts;
+    std::vector<char> labels, values;
+
+    // children of node are first..end-1, for one select
+    void children(uint64_t node, uint64_t &first, uint64_t &end) const {
+        uint64_t ones = node ? louds.select0(node - 1) + 1 : 0;
+        first = ones - node + 1;
+        end = louds.nextZero(ones) - node + 1;
+    }
+
+    // the child of node whose label starts with c, 0 if there is none
+    uint64_t child(uint64_t node, uint8_t c) const;
+
+    const char *label(uint64_t node, int &size) const {
+        uint64_t start = labelStarts.select1(node - 1);
+        size = labelStarts.nextOne(start + 1) - start;
+        return labels.data() + start;
+    }
+
+    Slice value(uint64_t node) const {
+        uint64_t start = valueStarts.select1(leaves.rank1(node));
+        return Slice((char *) values.data() + start, valueStarts.nextOne(start + 1) - start - 1);
+    }
+
+    template<typename F>
+    void walk(uint64_t node, char *key, int depth, F &f) const;
+
+public:
+    // copies every entry of T, which is left as it is
+    explicit FrozenTrie(CompressedTrie &T);
+
+    FrozenTrie(const FrozenTrie &) = delete;
+
+    FrozenTrie &operator=(const FrozenTrie &) = delete;
+
+    int size() const {
+        return leaves.rank1(leaves.size());
+    }
+
+    bool search(const Slice &key, Slice &value) const;
+
+    // N-th key (one-indexed), the key is malloc'd like CompressedTrie's
+    bool search(int N, Slice &key, Slice &value) const;
+
+    // calls f(key, value) for every entry starting with prefix, in key order
+    template<typename F>
+    void prefixScan(const Slice &prefix, F f) const;
+
+    // calls f(key, value) for every entry in key order
+    template<typename F>
+    void forEach(F f) const {
+        prefixScan(Slice(nullptr, 0), f);
+    }
+
+    // heap bytes held, bit string indexes included
+    size_t bytes() const {
+        return louds.bytes() + leaves.bytes() + inner.bytes() + labelStarts.bytes() + valueStarts.bytes() +
+               keys.capacity() + counts.capacity() * sizeof(uint32_t) + labels.capacity() + values.capacity();
+    }
+};
+
+template<typename F>
+void FrozenTrie::prefixScan(const Slice &prefix, F f) const {
+    char key[256];
+    uint64_t node = 0;
+    int depth = 0;
+    // down to the node whose label covers the end of prefix
+    while (depth < prefix.size) {
+        node = child(node, prefix.data[depth]);
+        if (!node)
+            return;
+        int size;
+        const char *l = label(node, size);
+        if (memcmp(l, prefix.data + depth, std::min(size, prefix.size - depth)))
+            return;
+        memcpy(key + depth, l, size);
+        depth += size;
+    }
+    walk(node, key, depth, f);
+}
+
+template<typename F>
+void FrozenTrie::walk(uint64_t node, char *key, int depth, F &f) const {
+    if (leaves[node])
+        f(Slice(key, depth), value(node));
+    uint64_t kid, end;
+    for (children(node, kid, end); kid < end; kid++) {
+        int size;
+        const char *l = label(kid, size);
+        memcpy(key + depth, l, size);
+        walk(kid, key, depth + size, f);
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef get_queue_h
+#define get_queue_h
+
+#include "ctrie.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#ifndef ASYNC_WORKERS
+#define ASYNC_WORKERS 2
+#endif
+// most lookups one worker answers per batch lookup
+#ifndef ASYNC_BATCH
+#define ASYNC_BATCH 256
+#endif
+
+struct GetResult {
+    bool found;
+    Slice value;
+};
+
+// Lookups queued by getAsync and answered by a pool of worker threads,
+// started on the first submit. A worker takes everything queued (up to
+// ASYNC_BATCH) and answers it with one call of the store's batch lookup,
+// so queued reads overlap their cache misses. Keys are copied on submit;
+// callbacks run on the worker once the whole batch is answered.
+class GetQueue {
+public:
+    typedef std::function<void(bool found, Slice value)> Callback;
+    typedef std::function<void(Slice *keys, Slice *values, bool *found, int n)> BatchLookup;
+
+private:
+    struct Request {
+        std::string key;
+        Callback done;
+    };
+
+    BatchLookup lookup;
+    std::deque<Request> pending;
+    std::vector<pthread_t> workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t wakeup;
+    bool stopping;
+
+    void serve(std::vector<Request> &batch) {
+        int n = batch.size();
+        std::vector<Slice> keys(n), values(n);
+        std::unique_ptr<bool[]> found(new bool[n]);
+        for (int i = 0; i < n; i++)
+            keys[i] = Slice(&batch[i].key[0], batch[i].key.size());
+        lookup(keys.data(), values.data(), found.get(), n);
+        for (int i = 0; i < n; i++)
+            batch[i].done(found[i], values[i]);
+    }
+
+    static void *loop(void *arg) {
+        auto self = (GetQueue *) arg;
+        std::vector<Request> batch;
+        pthread_mutex_lock(&self->mutex);
+        while (true) {
+            while (self->pending.empty() && !self->stopping)
+                pthread_cond_wait(&self->wakeup, &self->mutex);
+            // stop() only ends a worker once the queue is drained
+            if (self->pending.empty())
+                break;
+
+            batch.clear();
+            while (!self->pending.empty() && batch.size() < ASYNC_BATCH) {
+                batch.push_back(std::move(self->pending.front()));
+                self->pending.pop_front();
+            }
+            pthread_mutex_unlock(&self->mutex);
+            self->serve(batch);
+            pthread_mutex_lock(&self->mutex);
+        }
+        pthread_mutex_unlock(&self->mutex);
+        return NULL;
+    }
+
+public:
+    explicit GetQueue(BatchLookup lookup) : lookup(lookup), stopping(false) {
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&wakeup, NULL);
+    }
+
+    GetQueue(const GetQueue &) = delete;
+
+    GetQueue &operator=(const GetQueue &) = delete;
+
+    ~GetQueue() {
+        stop();
+        pthread_cond_destroy(&wakeup);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void submit(const Slice &key, Callback done) {
+        pthread_mutex_lock(&mutex);
+        if (stopping) {
+            // no workers left, answer on the caller's thread
+            pthread_mutex_unlock(&mutex);
+            std::vector<Request> one(1);
+            one[0].key.assign(key.data, key.size);
+            one[0].done = std::move(done);
+            serve(one);
+            return;
+        }
+        if (workers.empty()) {
+            workers.resize(ASYNC_WORKERS);
+            for (auto &w : workers)
+                pthread_create(&w, NULL, loop, this);
+        }
+        pending.push_back({std::string(key.data, key.size), std::move(done)});
+        pthread_cond_signal(&wakeup);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    // answers everything still queued, then joins the workers
+    void stop() {
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_broadcast(&wakeup);
+        pthread_mutex_unlock(&mutex);
+        for (auto &w : workers)
+            pthread_join(w, NULL);
+        workers.clear();
+    }
+};
+
+#endif
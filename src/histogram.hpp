@@ -0,0 +1,85 @@
+#ifndef histogram_h
+#define histogram_h
+
+#include <cstdint>
+#include <time.h>
+
+// Log-linear buckets like an HDR histogram: 2^HIST_SUB_BITS per power of
+// two, so a bucket is within 1/16 of its values; everything from
+// 2^HIST_MAX_BITS ns (about 18 minutes) on shares the last one.
+#define HIST_SUB_BITS 4
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+static inline uint64_t nowNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// Nanosecond latencies. Only the owning thread records, with plain
+// relaxed stores, while others may read a consistent-enough copy.
+class LatencyHistogram {
+    uint64_t counts[HIST_BUCKETS] = {};
+    uint64_t samples = 0, longest = 0;
+
+    static int bucket(uint64_t ns) {
+        if (ns < (1u << HIST_SUB_BITS))
+            return ns;
+        int shift = 63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+        if (shift >= HIST_MAX_BITS - HIST_SUB_BITS)
+            return HIST_BUCKETS - 1;
+        return ((shift + 1) << HIST_SUB_BITS) + (int) ((ns >> shift) & ((1u << HIST_SUB_BITS) - 1));
+    }
+
+    // the largest value bucket b holds
+    static uint64_t highest(int b) {
+        if (b < (1 << HIST_SUB_BITS))
+            return b;
+        int shift = (b >> HIST_SUB_BITS) - 1;
+        uint64_t sub = (b & ((1 << HIST_SUB_BITS) - 1)) | (1 << HIST_SUB_BITS);
+        return ((sub + 1) << shift) - 1;
+    }
+
+    static void bump(uint64_t &field, uint64_t by) {
+        __atomic_store_n(&field, __atomic_load_n(&field, __ATOMIC_RELAXED) + by, __ATOMIC_RELAXED);
+    }
+
+public:
+    void record(uint64_t ns) {
+        bump(counts[bucket(ns)], 1);
+        bump(samples, 1);
+        if (ns > __atomic_load_n(&longest, __ATOMIC_RELAXED))
+            __atomic_store_n(&longest, ns, __ATOMIC_RELAXED);
+    }
+
+    void add(const LatencyHistogram &other) {
+        for (int b = 0; b < HIST_BUCKETS; b++)
+            counts[b] += __atomic_load_n(&other.counts[b], __ATOMIC_RELAXED);
+        samples += __atomic_load_n(&other.samples, __ATOMIC_RELAXED);
+        uint64_t m = __atomic_load_n(&other.longest, __ATOMIC_RELAXED);
+        longest = m > longest ? m : longest;
+    }
+
+    uint64_t count() const {
+        return samples;
+    }
+
+    uint64_t max() const {
+        return longest;
+    }
+
+    // the latency a fraction q of the samples are at or below, rounded up
+    // to the end of its bucket
+    uint64_t percentile(double q) const {
+        uint64_t rank = (uint64_t) (q * samples), seen = 0;
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            seen += counts[b];
+            if (seen > rank || seen == samples)
+                return highest(b) < longest ? highest(b) : longest;
+        }
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef instrument_h
+#define instrument_h
+
+// Built with -DFASTMAP_INSTRUMENT, kvStore times every get, put, del,
+// get(N) and del(N), how long callers wait for its lock and how long
+// writers hold it, and the trie counts the structural work writes do. Each
+// thread records into a buffer of its own, which kvStore::instrumentation()
+// merges. Without the flag none of it is compiled in: INSTRUMENTED(...)
+// drops its arguments and the types below don't exist.
+
+#ifdef FASTMAP_INSTRUMENT
+
+#include "histogram.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#define INSTRUMENTED(...) __VA_ARGS__
+
+enum InstrumentedOp { OP_GET, OP_PUT, OP_DEL, OP_GET_N, OP_DEL_N, OP_KINDS };
+
+// what one thread recorded, or all of them merged
+struct OpLatencies {
+    LatencyHistogram ops[OP_KINDS];
+    // until the lock was granted, shared or exclusive, and exclusive holds
+    LatencyHistogram readWait, writeWait, writeHold;
+
+    void add(const OpLatencies &other) {
+        for (int op = 0; op < OP_KINDS; op++)
+            ops[op].add(other.ops[op]);
+        readWait.add(other.readWait);
+        writeWait.add(other.writeWait);
+        writeHold.add(other.writeHold);
+    }
+};
+
+// Per-thread buffers of one store. A thread finds its buffer through a
+// thread-local list keyed by store id, which is never reused, so entries
+// left behind by a destroyed store are never mistaken for a live one's.
+class Instruments {
+    uint64_t id;
+    std::mutex mutex;
+    std::vector<OpLatencies *> buffers;
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> ids(0);
+        return ++ids;
+    }
+
+public:
+    Instruments() : id(nextId()) {}
+
+    ~Instruments() {
+        for (auto *b : buffers)
+            delete b;
+    }
+
+    Instruments(const Instruments &) = delete;
+
+    Instruments &operator=(const Instruments &) = delete;
+
+    OpLatencies &local() {
+        static thread_local std::vector<std::pair<uint64_t, OpLatencies *>> mine;
+        for (auto &m : mine)
+            if (m.first == id)
+                return *m.second;
+        auto *b = new OpLatencies();
+        {
+            std::lock_guard<std::mutex> hold(mutex);
+            buffers.push_back(b);
+        }
+        mine.push_back({id, b});
+        return *b;
+    }
+
+    OpLatencies merged() {
+        OpLatencies all;
+        std::lock_guard<std::mutex> hold(mutex);
+        for (auto *b : buffers)
+            all.add(*b);
+        return all;
+    }
+};
+
+// records the time until it goes out of scope
+class ScopeTimer {
+    LatencyHistogram &into;
+    uint64_t start;
+
+public:
+    explicit ScopeTimer(LatencyHistogram &into) : into(into), start(nowNs()) {}
+
+    ~ScopeTimer() {
+        into.record(nowNs() - start);
+    }
+};
+
+// structural work of a trie's writers, who hold it exclusively, and of
+// settle(), which runs one at a time
+struct TrieCounters {
+    // nodes split in two where a key parts from an edge label
+    uint64_t splits = 0;
+    // nodes merged with their only child after a delete
+    uint64_t merges = 0;
+    // pending leaf counts settle() passed on toward root
+    uint64_t settleSteps = 0;
+};
+
+struct Instrumentation {
+    OpLatencies latencies;
+    TrieCounters trie;
+};
+
+#else
+
+#define INSTRUMENTED(...)
+
+#endif
+
+#endif
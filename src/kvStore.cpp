@@ -1,62 +1,579 @@
 #ifndef FASTER
 #define FASTER
 
+#include <algorithm>
 #include <cassert>
+#include "background.hpp"
 #include "ctrie.hpp"
+#include "frozenTrie.hpp"
+#include "getQueue.hpp"
+#include "instrument.hpp"
+#include "snapshot.hpp"
+#include "wal.hpp"
+#include <atomic>
 #include <cstring>
+#include <future>
+#include <pthread.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
 
 /* struct Slice { */
 /*     int size; */
 /*     char *data; */
 /* }; */
+// kvStore::stats(). Until the first write, a store that loaded a snapshot
+// or was frozen holds its entries there and trie is (nearly) empty.
+struct StoreStats {
+    uint64_t entries = 0;
+    TrieStats trie;
+    // kept mapped, or allocated, for older slices even once the trie has
+    // been rebuilt from them
+    uint64_t snapshotBytes = 0, frozenBytes = 0;
+    // arenas and frozen tries a freeze replaced, freed by the compactor
+    uint64_t staleBytes = 0;
+
+    uint64_t bytes() const {
+        return trie.bytes() + snapshotBytes + frozenBytes + staleBytes;
+    }
+};
+
+// Keys and values are copied into the store. Slices returned by get point
+// into the store's log; compaction may move them, but the old copy stays
+// readable for at least COMPACT_INTERVAL_MS.
 class kvStore {
    private:
     CompressedTrie T;
-    pthread_mutex_t lock;
+    // writers hold it exclusively; get(key) and multiGet take no lock (see
+    // CompressedTrie), rank queries and cursors share it
+    pthread_rwlock_t lock;
+    BackgroundTask compactor;
+    GetQueue gets;
+    // set by loadSnapshot and kept mapped for older slices
+    Snapshot *snapshot;
+    // the snapshot gets are served from until the first write copies it
+    // into T, null from then on
+    std::atomic<Snapshot *> mapped;
+    // set by freeze and kept for older slices
+    FrozenTrie *frozen;
+    // the frozen trie gets are served from until the first write thaws it
+    // into T, null from then on
+    std::atomic<FrozenTrie *> sealed;
+    // what a freeze replaced, and the compactor steps left until it is freed
+    struct Stale {
+        TrieArena *arena;
+        FrozenTrie *frozen;
+        int steps;
+    };
+    std::vector<Stale> stale;
+    // set by enableWal, along with where checkpoints go
+    WriteAheadLog *wal;
+    std::string checkpointPath;
+#ifdef FASTMAP_INSTRUMENT
+    Instruments instruments;
+    // when the current exclusive hold began
+    uint64_t heldSince;
+#endif
+
+    Snapshot *serving() const {
+        return mapped.load(std::memory_order_acquire);
+    }
+
+    FrozenTrie *sealedTrie() const {
+        return sealed.load(std::memory_order_acquire);
+    }
+
+    // the lock, with waits and exclusive holds timed when instrumented
+    void lockRead() {
+        INSTRUMENTED(uint64_t asked = nowNs();)
+        pthread_rwlock_rdlock(&lock);
+        INSTRUMENTED(instruments.local().readWait.record(nowNs() - asked);)
+    }
+
+    void unlockRead() {
+        pthread_rwlock_unlock(&lock);
+    }
+
+    void lockWrite() {
+        INSTRUMENTED(uint64_t asked = nowNs();)
+        pthread_rwlock_wrlock(&lock);
+        INSTRUMENTED(heldSince = nowNs();)
+        INSTRUMENTED(instruments.local().writeWait.record(heldSince - asked);)
+    }
+
+    void unlockWrite() {
+        INSTRUMENTED(instruments.local().writeHold.record(nowNs() - heldSince);)
+        pthread_rwlock_unlock(&lock);
+    }
+
+    // inserts every entry of a snapshot or frozen trie into T
+    template<typename Source>
+    void refill(const Source &source) {
+        // keys arrive sorted, so each insert resumes from the last one. The
+        // finger still points at the previous key, which forEach overwrites,
+        // hence the copies.
+        TrieFinger finger;
+        char copies[2][256];
+        int flip = 0;
+        source.forEach([&](const Slice &key, const Slice &value) {
+            memcpy(copies[flip], key.data, key.size);
+            T.insert(Slice(copies[flip], key.size), value, &finger);
+            flip ^= 1;
+        });
+    }
+
+    // called with the lock held exclusively before anything modifies T
+    void hydrate() {
+        if (serving()) {
+            refill(*snapshot);
+            mapped.store(nullptr, std::memory_order_release);
+        } else if (sealedTrie()) {
+            refill(*frozen);
+            sealed.store(nullptr, std::memory_order_release);
+        }
+    }
+
+    // maps path as the store's content, with the lock held exclusively
+    bool mapSnapshot(const char *path) {
+        auto *s = new Snapshot();
+        if (!s->open(path)) {
+            delete s;
+            return false;
+        }
+        snapshot = s;
+        mapped.store(s, std::memory_order_release);
+        return true;
+    }
+
+    // Writes applied with the lock held are logged before it is released,
+    // so the log replays them in the same order. The writer then waits for
+    // its ticket outside the lock.
+    uint64_t logged(WalOp op, const Slice &key, const Slice &value = Slice(nullptr, 0), int N = 0) {
+        return wal ? wal->append(op, key, value, N) : 0;
+    }
+
+    void commit(uint64_t ticket) {
+        if (ticket)
+            wal->commit(ticket);
+    }
+
+    // one segment per lock hold, so writers get in between. Segments emptied
+    // by the previous step are freed first, a full interval after retiring.
+    void compactStep() {
+        lockWrite();
+        T.reclaim();
+        for (size_t i = 0; i < stale.size();) {
+            if (--stale[i].steps > 0) {
+                i++;
+                continue;
+            }
+            delete stale[i].arena;
+            delete stale[i].frozen;
+            stale.erase(stale.begin() + i);
+        }
+        unlockWrite();
+
+        // leaf counts the writes left stale, off the path of the next rank
+        // query; readers carry on meanwhile
+        lockRead();
+        T.settle();
+        unlockRead();
+
+        bool more = true;
+        while (more) {
+            lockWrite();
+            more = T.garbageRatio() > COMPACT_THRESHOLD && T.compact();
+            unlockWrite();
+        }
+
+        if (wal && wal->size() > WAL_CHECKPOINT_BYTES)
+            checkpoint();
+    }
 
    public:
-    kvStore(uint64_t max_entries) { }
+    // max_entries pre-sizes the trie's allocation slabs, hugePages asks the
+    // kernel to back them with transparent huge pages
+    kvStore(uint64_t max_entries, bool hugePages = false)
+        : T(max_entries, hugePages),
+          gets([this](Slice *keys, Slice *values, bool *found, int n) {
+              multiGet(keys, values, found, n);
+          }),
+          snapshot(nullptr),
+          mapped(nullptr),
+          frozen(nullptr),
+          sealed(nullptr),
+          wal(nullptr) {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+        // queue new readers behind a waiting writer so puts don't starve
+        pthread_rwlockattr_setkind_np(
+            &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        pthread_rwlock_init(&lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+        compactor.start([this] { compactStep(); }, COMPACT_INTERVAL_MS);
+    }
+
+    ~kvStore() {
+        gets.stop();
+        compactor.stop();
+        delete wal;
+        pthread_rwlock_destroy(&lock);
+        delete snapshot;
+        delete frozen;
+        for (auto &s : stale) {
+            delete s.arena;
+            delete s.frozen;
+        }
+    }
 
+    // Makes puts and dels durable. An empty store first maps the last
+    // checkpoint at snapshotPath, if there is one, and replays walPath on
+    // top of it; from then on every write is logged to walPath before it
+    // returns (see SyncPolicy), and the log is folded into a new snapshot
+    // once it outgrows WAL_CHECKPOINT_BYTES. Returns false if the store
+    // isn't empty or either file can't be read.
+    bool enableWal(const char *walPath, const char *snapshotPath, SyncPolicy policy = SYNC_BATCH) {
+        lockWrite();
+        bool result = false;
+        if (!wal && !snapshot && !sealedTrie() && T.empty() &&
+            (mapSnapshot(snapshotPath) || access(snapshotPath, F_OK) != 0)) {
+            wal = new WriteAheadLog();
+            uint64_t covered = snapshot ? snapshot->logPosition() : 0;
+            result = wal->open(walPath, policy, covered, [this](WalOp op, const Slice &key, const Slice &value, int N) {
+                hydrate();
+                if (op == WAL_PUT)
+                    T.insert(key, value);
+                else if (op == WAL_DEL)
+                    T.del(key);
+                else
+                    T.del(N + 1);
+            });
+            if (result) {
+                checkpointPath = snapshotPath;
+            } else {
+                delete wal;
+                wal = nullptr;
+            }
+        }
+        unlockWrite();
+        return result;
+    }
+
+    // writes a snapshot for enableWal's snapshotPath and empties the log,
+    // blocking the store meanwhile like saveSnapshot
+    bool checkpoint() {
+        if (!wal)
+            return false;
+        lockWrite();
+        hydrate();
+        auto result = writeSnapshot(T, checkpointPath.c_str(), wal->position());
+        if (result)
+            wal->truncate();
+        unlockWrite();
+        return result;
+    }
+
+    // writes every entry to path in a format loadSnapshot can map,
+    // returns false on I/O errors
+    bool saveSnapshot(const char *path) {
+        lockWrite();
+        hydrate();
+        auto result = writeSnapshot(T, path);
+        unlockWrite();
+        return result;
+    }
+
+    // Maps a file written by saveSnapshot into an empty store. Reads are
+    // answered from the mapping right away, touching only the pages they
+    // need; the first put/del rebuilds the trie from it. Returns false if
+    // the store isn't empty or path isn't a snapshot.
+    bool loadSnapshot(const char *path) {
+        lockWrite();
+        bool result = false;
+        if (!snapshot && !sealedTrie() && T.empty())
+            result = mapSnapshot(path);
+        unlockWrite();
+        return result;
+    }
+
+    // keeps a 52^4 jump table (58MB virtual) from 4-letter key prefixes into
+    // the trie, so lookups of longer keys skip the top levels
+    void enablePrefixCache() {
+        lockWrite();
+        hydrate();
+        T.enablePrefixIndex();
+        unlockWrite();
+    }
+
+    // Re-encodes the store as a FrozenTrie, a fraction of the trie's size,
+    // and frees the trie (after COMPACT_INTERVAL_MS, for older slices).
+    // get, multiGet, get(N) and prefixScan are answered from it until the
+    // first put/del (or cursor) rebuilds the trie from it.
+    void freeze() {
+        lockWrite();
+        if (!sealedTrie()) {
+            hydrate();
+            auto *f = new FrozenTrie(T);
+            sealed.store(f, std::memory_order_release);
+            // two steps, so a full interval passes before either is freed
+            stale.push_back({T.clear(), frozen, 2});
+            frozen = f;
+        }
+        unlockWrite();
+    }
+
+    // Live entries and where the memory goes. The counters are kept up to
+    // date by the writers (entries may first settle the leaf counts of
+    // writes since the last compactor step), so this is cheap enough to
+    // poll; walk also fills the depth and fanout histograms, visiting every
+    // node while puts and dels wait.
+    StoreStats stats(bool walk = false) {
+        StoreStats s;
+        lockRead();
+        s.trie = T.stats(walk);
+        s.entries = s.trie.entries;
+        if (Snapshot *m = serving())
+            s.entries = m->size();
+        else if (FrozenTrie *f = sealedTrie())
+            s.entries = f->size();
+        s.snapshotBytes = snapshot ? snapshot->mappedBytes() : 0;
+        s.frozenBytes = frozen ? frozen->bytes() : 0;
+        for (auto &old : stale)
+            s.staleBytes += old.arena->reservedBytes() + (old.frozen ? old.frozen->bytes() : 0);
+        unlockRead();
+        return s;
+    }
+
+#ifdef FASTMAP_INSTRUMENT
+    // what every thread recorded so far, see instrument.hpp
+    Instrumentation instrumentation() {
+        Instrumentation all;
+        all.latencies = instruments.merged();
+        pthread_rwlock_rdlock(&lock);
+        {
+            // settle() counts too, next to other readers
+            std::lock_guard<std::mutex> hold(T.settling);
+            all.trie = T.counters;
+        }
+        pthread_rwlock_unlock(&lock);
+        return all;
+    }
+
+#endif
     // returns false if key didn’t exist
     bool get(Slice &key, Slice &value) {
-        pthread_mutex_lock(&lock);
-        auto result = T.search(key, value);
-        pthread_mutex_unlock(&lock);
-        return result;
+        INSTRUMENTED(ScopeTimer timer(instruments.local().ops[OP_GET]);)
+        EpochGuard guard(T.epochs);
+        if (Snapshot *s = serving())
+            return s->search(key, value);
+        if (FrozenTrie *f = sealedTrie())
+            return f->search(key, value);
+        return T.search(key, value);
+    }
+
+    // Non-blocking get, answered by a worker thread together with whatever
+    // else is queued (ASYNC_WORKERS, ASYNC_BATCH). The key is copied, the
+    // value slice has the same lifetime as one returned by get.
+    std::future<GetResult> getAsync(const Slice &key) {
+        auto promise = std::make_shared<std::promise<GetResult>>();
+        gets.submit(key, [promise](bool found, Slice value) {
+            promise->set_value({found, value});
+        });
+        return promise->get_future();
+    }
+
+    // same, calling done on the worker thread instead
+    void getAsync(const Slice &key, GetQueue::Callback done) {
+        gets.submit(key, std::move(done));
     }
 
     // returns true if value overwritten
     bool put(Slice &key, Slice &value) {
-        pthread_mutex_lock(&lock);
+        INSTRUMENTED(ScopeTimer timer(instruments.local().ops[OP_PUT]);)
+        lockWrite();
+        hydrate();
         auto result = T.insert(key, value);
-        pthread_mutex_unlock(&lock);
+        auto ticket = logged(WAL_PUT, key, value);
+        unlockWrite();
+        commit(ticket);
         return result;
     }
 
     bool del(Slice &key) {
-        pthread_mutex_lock(&lock);
+        INSTRUMENTED(ScopeTimer timer(instruments.local().ops[OP_DEL]);)
+        lockWrite();
+        hydrate();
         auto result = T.del(key);
-        pthread_mutex_unlock(&lock);
+        auto ticket = result ? logged(WAL_DEL, key) : 0;
+        unlockWrite();
+        commit(ticket);
+        return result;
+    }
+
+    // Batched get/put/del, writes under one lock hold per batch. Reads
+    // interleave the walks of several keys so their cache misses overlap.
+    // Writes first walk all paths that way, then apply the keys in sorted
+    // order, each resuming from the path it shares with the previous key.
+    // Results are written in the callers' order, duplicate keys are applied
+    // in batch order. Each returns how many keys were found / overwritten /
+    // deleted.
+    int multiGet(Slice *keys, Slice *values, bool *found, int n) {
+        EpochGuard guard(T.epochs);
+        Snapshot *s = serving();
+        FrozenTrie *f = sealedTrie();
+        if (s) {
+            for (int k = 0; k < n; k++)
+                found[k] = s->search(keys[k], values[k]);
+        } else if (f) {
+            for (int k = 0; k < n; k++)
+                found[k] = f->search(keys[k], values[k]);
+        } else {
+            T.searchBatch(keys, nullptr, n, values, found);
+        }
+        return count(found, found + n, true);
+    }
+
+    int multiPut(Slice *keys, Slice *values, bool *overwritten, int n) {
+        vector<int> order;
+        sortBatch(keys, n, order);
+        TrieFinger finger;
+        uint64_t ticket = 0;
+        lockWrite();
+        hydrate();
+        T.searchBatch(keys, order.data(), n, nullptr, nullptr);
+        for (int idx : order) {
+            overwritten[idx] = T.insert(keys[idx], values[idx], &finger);
+            ticket = logged(WAL_PUT, keys[idx], values[idx]);
+        }
+        unlockWrite();
+        commit(ticket);
+        return count(overwritten, overwritten + n, true);
+    }
+
+    int multiDel(Slice *keys, bool *deleted, int n) {
+        vector<int> order;
+        sortBatch(keys, n, order);
+        TrieFinger finger;
+        uint64_t ticket = 0;
+        lockWrite();
+        hydrate();
+        T.searchBatch(keys, order.data(), n, nullptr, nullptr);
+        for (int idx : order) {
+            deleted[idx] = T.del(keys[idx], &finger);
+            if (deleted[idx])
+                ticket = logged(WAL_DEL, keys[idx]);
+        }
+        unlockWrite();
+        commit(ticket);
+        return count(deleted, deleted + n, true);
+    }
+
+    // Fills an empty store with n entries far faster than put: sorts them
+    // (unless sorted is set) and builds the trie bottom-up in one pass.
+    // Sorted input is checked on the way; from the first key out of order
+    // on, the rest is put one by one. With threads > 1, the sorting and building is
+    // split by leading character over that many threads (see
+    // CompressedTrie::parallelLoad). Repeated keys keep the last value.
+    // Returns false if the store isn't empty. With a write-ahead log, the
+    // loaded store is checkpointed before returning instead of logging
+    // each key.
+    bool bulkLoad(Slice *keys, Slice *values, int n, bool sorted = false, int threads = 1) {
+        vector<int> order;
+        if (!sorted && threads <= 1)
+            sortBatch(keys, n, order);
+        lockWrite();
+        bool result = !snapshot && !sealedTrie() && T.empty();
+        if (result && threads > 1)
+            T.parallelLoad(keys, values, n, sorted, threads);
+        else if (result)
+            T.bulkLoad(keys, values, sorted ? nullptr : order.data(), n);
+        unlockWrite();
+        if (result && wal)
+            result = checkpoint();
         return result;
     }
 
+    // Ordered iteration, see TrieCursor. Holds the read lock from
+    // construction to destruction, so key/value slices stay valid until then
+    // and puts/dels wait. N is zero-indexed like get(N). A store still
+    // serving a snapshot or a frozen trie is hydrated first.
+    class Cursor : public TrieCursor {
+        pthread_rwlock_t *lock;
+
+       public:
+        Cursor(kvStore &kv, char *buffer)
+            : TrieCursor(&kv.T, buffer), lock(&kv.lock) {
+            pthread_rwlock_rdlock(lock);
+            if (kv.serving() || kv.sealedTrie()) {
+                pthread_rwlock_unlock(lock);
+                pthread_rwlock_wrlock(lock);
+                kv.hydrate();
+                pthread_rwlock_unlock(lock);
+                pthread_rwlock_rdlock(lock);
+            }
+        }
+
+        ~Cursor() {
+            pthread_rwlock_unlock(lock);
+        }
+
+        Cursor(const Cursor &) = delete;
+
+        Cursor &operator=(const Cursor &) = delete;
+
+        using TrieCursor::seek;
+
+        bool seek(int N) {
+            return TrieCursor::seek(N + 1);
+        }
+    };
+
     // N in benchmark.cpp is zero-indexed
     // N in trieFinal.hpp is one-indexed
 
     // returns Nth key-value pair
     bool get(int N, Slice &key, Slice &value) {
-        pthread_mutex_lock(&lock);
-        auto result = T.search(N + 1, key, value);
-        pthread_mutex_unlock(&lock);
+        INSTRUMENTED(ScopeTimer timer(instruments.local().ops[OP_GET_N]);)
+        lockRead();
+        Snapshot *s = serving();
+        FrozenTrie *f = sealedTrie();
+        auto result = s ? s->search(N + 1, key, value)
+                        : f ? f->search(N + 1, key, value) : T.search(N + 1, key, value);
+        unlockRead();
         return result;
     }
 
+    // Calls f(key, value) for every entry starting with prefix, in key
+    // order, with puts/dels waiting until it returns. A frozen store is
+    // scanned as it is, otherwise this is a Cursor's prefixScan.
+    template<typename F>
+    void prefixScan(const Slice &prefix, F f) {
+        lockRead();
+        FrozenTrie *frozenNow = sealedTrie();
+        if (frozenNow)
+            frozenNow->prefixScan(prefix, f);
+        unlockRead();
+        if (frozenNow)
+            return;
+
+        char buffer[256];
+        Cursor cursor(*this, buffer);
+        for (bool ok = cursor.prefixScan(prefix); ok; ok = cursor.next())
+            f(cursor.key(), cursor.value());
+    }
+
     // delete Nth key-value pair
     bool del(int N) {
+        INSTRUMENTED(ScopeTimer timer(instruments.local().ops[OP_DEL_N]);)
         /* return root->erase(N + 1); */
-        pthread_mutex_lock(&lock);
+        lockWrite();
+        hydrate();
         auto result = T.del(N + 1);
-        pthread_mutex_unlock(&lock);
+        auto ticket = result ? logged(WAL_DEL_N, Slice(nullptr, 0), Slice(nullptr, 0), N) : 0;
+        unlockWrite();
+        commit(ticket);
         return result;
     }
 };
@@ -0,0 +1,165 @@
+#ifndef label_h
+#define label_h
+
+#include <cstdint>
+#include <cstring>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+// Edge labels as the log keeps them. By default a label is the key bytes it
+// spans. Built with PACKED_LABELS, keys may only use digits, letters and
+// '_', and labels take 6 bits per character (eight characters to six
+// bytes), a quarter less label memory; comparisons then pack the key side
+// on the fly. Nothing checks the keys: any other byte packs as code 0, so
+// keys differing only in such bytes compare equal and are taken for one
+// another. Otherwise labels are compared with matchLength below.
+
+// Leading bytes a and b have in common, at most n. Whole vectors are
+// compared while at least one fits (32 bytes with AVX2, picked at run time,
+// 16 with SSE2), then words, then bytes; nothing past a + n or b + n is
+// read. The kernels, which start comparing at byte m, are exposed for
+// tests/matchBench.cpp.
+
+static inline int matchWords(const char *a, const char *b, int m, int n) {
+    for (; m + 8 <= n; m += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + m, 8);
+        memcpy(&y, b + m, 8);
+        // the lowest differing bit is in the first differing byte
+        if (x != y)
+            return m + __builtin_ctzll(x ^ y) / 8;
+    }
+    while (m < n && a[m] == b[m])
+        m++;
+    return m;
+}
+
+#ifdef __SSE2__
+
+static inline int matchSse2(const char *a, const char *b, int m, int n) {
+    for (; m + 16 <= n; m += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + m));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + m));
+        unsigned differ = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xffff;
+        if (differ)
+            return m + __builtin_ctz(differ);
+    }
+    return matchWords(a, b, m, n);
+}
+
+__attribute__((target("avx2")))
+static inline int matchAvx2(const char *a, const char *b, int m, int n) {
+    for (; m + 32 <= n; m += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + m));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + m));
+        unsigned differ = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (differ)
+            return m + __builtin_ctz(differ);
+    }
+    return matchSse2(a, b, m, n);
+}
+
+static inline bool cpuHasAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool hasAvx2 = cpuHasAvx2();
+
+static inline int matchLength(const char *a, const char *b, int n) {
+    // most labels are shorter than a vector
+    if (n < 16)
+        return matchWords(a, b, 0, n);
+    return hasAvx2 ? matchAvx2(a, b, 0, n) : matchSse2(a, b, 0, n);
+}
+
+#else
+
+static inline int matchLength(const char *a, const char *b, int n) {
+    return matchWords(a, b, 0, n);
+}
+
+#endif
+
+#ifdef PACKED_LABELS
+
+// 6-bit character codes in ASCII order, 0 for bytes keys may not use
+struct LabelCodes {
+    uint8_t code[256];
+    char character[64];
+
+    constexpr LabelCodes() : code(), character() {
+        const char alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+        for (int i = 0; i < 63; i++) {
+            code[(uint8_t) alphabet[i]] = i + 1;
+            character[i + 1] = alphabet[i];
+        }
+    }
+};
+
+static constexpr LabelCodes labelCodes{};
+
+static inline uint32_t labelBytes(int size) {
+    return (size * 6 + 7) / 8;
+}
+
+// count (at most 8) characters of a packed label from character at on,
+// one per 6 bits from the lowest; reads only bytes holding them
+static inline uint64_t packedChars(const char *label, int at, int count) {
+    int bit = at * 6, shift = bit % 8;
+    uint64_t word = 0;
+    memcpy(&word, label + bit / 8, (shift + count * 6 + 7) / 8);
+    return (word >> shift) & ((1ULL << (count * 6)) - 1);
+}
+
+static inline void packLabel(const char *from, int size, char *to) {
+    uint64_t bits = 0;
+    int held = 0;
+    for (int i = 0; i < size; i++) {
+        bits |= (uint64_t) labelCodes.code[(uint8_t) from[i]] << held;
+        held += 6;
+        for (; held >= 8; held -= 8, bits >>= 8)
+            *to++ = (char) bits;
+    }
+    if (held)
+        *to = (char) bits;
+}
+
+static inline void unpackLabel(const char *from, int size, char *to) {
+    for (int i = 0; i < size; i += 8) {
+        int count = size - i < 8 ? size - i : 8;
+        uint64_t chars = packedChars(from, i, count);
+        for (int k = 0; k < count; k++, chars >>= 6)
+            to[i + k] = labelCodes.character[chars & 63];
+    }
+}
+
+// leading characters of the stored label, from character at on, that match
+// key, at most n
+static inline int labelMatch(const char *label, int at, const char *key, int n) {
+    for (int m = 0; m < n; m += 8) {
+        int count = n - m < 8 ? n - m : 8;
+        uint64_t want = 0;
+        for (int k = 0; k < count; k++)
+            want |= (uint64_t) labelCodes.code[(uint8_t) key[m + k]] << (6 * k);
+        uint64_t diff = want ^ packedChars(label, at + m, count);
+        if (diff)
+            return m + __builtin_ctzll(diff) / 6;
+    }
+    return n;
+}
+
+#else
+
+static inline uint32_t labelBytes(int size) {
+    return size;
+}
+
+static inline int labelMatch(const char *label, int at, const char *key, int n) {
+    return matchLength(label + at, key, n);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef pool_h
+#define pool_h
+
+#include <cstddef>
+#include <new>
+#include <sys/mman.h>
+#include <utility>
+#include <vector>
+
+#define POOL_SLAB_BYTES (1 << 20)
+#define HUGE_PAGE_BYTES (2 << 20)
+
+// Fixed-size object pool. Objects are carved out of large mmap'd slabs and
+// freed ones are recycled through an intrusive free list, so steady-state
+// allocation never reaches malloc. A pool is not thread-safe: each trie owns
+// its pools and only touches them under its writer lock. Objects lock-free
+// readers may still be looking at are retired instead of released and only
+// recycled after two calls of age(), one per reclamation epoch.
+template<typename T>
+class Pool {
+    union Cell {
+        Cell *next;
+        alignas(T) char data[sizeof(T)];
+    };
+
+    struct Slab {
+        Cell *cells;
+        size_t bytes;
+    };
+
+    std::vector<Slab> slabs;
+    Cell *freeList = nullptr;
+    Cell *cursor = nullptr, *end = nullptr;
+    size_t live = 0;
+    // retired since the last age(), and before that
+    std::vector<T *> retiring, retired;
+
+    void addSlab(size_t objects) {
+        size_t bytes = objects * sizeof(Cell);
+        void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        if (hugePages && bytes >= HUGE_PAGE_BYTES)
+            madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+        slabs.push_back({(Cell *) mem, bytes});
+        cursor = (Cell *) mem;
+        end = cursor + objects;
+    }
+
+public:
+    // ask for transparent huge pages on slabs of at least 2MB
+    bool hugePages = false;
+
+    Pool() = default;
+
+    Pool(const Pool &) = delete;
+
+    Pool &operator=(const Pool &) = delete;
+
+    ~Pool() {
+        for (auto &slab : slabs)
+            munmap(slab.cells, slab.bytes);
+    }
+
+    // make room for at least n more objects in a single slab
+    void reserve(size_t n) {
+        if ((size_t) (end - cursor) < n)
+            addSlab(n);
+    }
+
+    template<typename... Args>
+    T *make(Args &&... args) {
+        Cell *cell = freeList;
+        if (cell) {
+            freeList = cell->next;
+        } else {
+            if (cursor == end)
+                addSlab(POOL_SLAB_BYTES / sizeof(Cell) + 1);
+            cell = cursor++;
+        }
+        live++;
+        return new(cell->data) T(std::forward<Args>(args)...);
+    }
+
+    void release(T *obj) {
+        if (!obj) return;
+        obj->~T();
+        Cell *cell = (Cell *) obj;
+        cell->next = freeList;
+        freeList = cell;
+        live--;
+    }
+
+    // like release, once readers can no longer reach obj (see above)
+    void retire(T *obj) {
+        if (obj)
+            retiring.push_back(obj);
+    }
+
+    // called when the epoch advances
+    void age() {
+        for (T *obj : retired)
+            release(obj);
+        retired.clear();
+        retired.swap(retiring);
+    }
+
+    // takes over every object and free cell of other, which is left empty;
+    // objects keep their addresses
+    void absorb(Pool &other) {
+        slabs.insert(slabs.end(), other.slabs.begin(), other.slabs.end());
+        if (other.freeList) {
+            Cell *tail = other.freeList;
+            while (tail->next)
+                tail = tail->next;
+            tail->next = freeList;
+            freeList = other.freeList;
+        }
+        live += other.live;
+        retiring.insert(retiring.end(), other.retiring.begin(), other.retiring.end());
+        retiring.insert(retiring.end(), other.retired.begin(), other.retired.end());
+        other.retiring.clear();
+        other.retired.clear();
+        other.slabs.clear();
+        other.freeList = other.cursor = other.end = nullptr;
+        other.live = 0;
+    }
+
+    // objects made and not yet released, retired ones included
+    size_t liveObjects() const {
+        return live;
+    }
+
+    size_t retiredObjects() const {
+        return retiring.size() + retired.size();
+    }
+
+    size_t reservedBytes() const {
+        size_t total = 0;
+        for (auto &slab : slabs)
+            total += slab.bytes;
+        return total;
+    }
+};
+
+#endif
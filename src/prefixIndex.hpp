@@ -0,0 +1,96 @@
+#ifndef prefix_index_h
+#define prefix_index_h
+
+#include "epoch.hpp"
+#include <cstdint>
+#include <cstdlib>
+
+struct CompressedTrieNode;
+
+#define PREFIX_LEN 4
+#define PREFIX_ALPHABET 52
+#define PREFIX_SLOTS (PREFIX_ALPHABET * PREFIX_ALPHABET * PREFIX_ALPHABET * PREFIX_ALPHABET)
+
+// Direct-mapped table from a 4-letter key prefix to the trie node whose
+// edge label holds the prefix's 4th character, so lookups can skip the top
+// of the trie. Exactly one node covers each prefix that is present, which
+// keeps maintenance to re-pointing a single slot whenever a node covering
+// depth 3 is created or split. Entries pack the node's start depth (0..3)
+// into the low bits of its pointer.
+class PrefixIndex {
+    uintptr_t *table;
+
+public:
+    PrefixIndex() {
+        // 58MB of virtual memory, pages are only faulted in when touched
+        table = (uintptr_t *) calloc(PREFIX_SLOTS, sizeof(uintptr_t));
+    }
+
+    ~PrefixIndex() {
+        free(table);
+    }
+
+    PrefixIndex(const PrefixIndex &) = delete;
+
+    PrefixIndex &operator=(const PrefixIndex &) = delete;
+
+    static int letter(char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        return -1;
+    }
+
+    // slot of the first 4 characters of p, -1 if one of them isn't [a-zA-Z]
+    static int slot(const char *p) {
+        int idx = 0;
+        for (int k = 0; k < PREFIX_LEN; k++) {
+            int l = letter(p[k]);
+            if (l < 0) return -1;
+            idx = idx * PREFIX_ALPHABET + l;
+        }
+        return idx;
+    }
+
+    // node covering key's first 4 characters (nullptr if no key starts with
+    // them), with offset set to the position right after them inside the
+    // node's edge label. Returns false if the key can't use the table.
+    bool find(const char *key, CompressedTrieNode *&node, int &offset) const {
+        int idx = slot(key);
+        if (idx < 0) return false;
+        uintptr_t entry = readShared(table[idx]);
+        node = (CompressedTrieNode *) (entry & ~(uintptr_t) 3);
+        offset = PREFIX_LEN - (int) (entry & 3);
+        return true;
+    }
+
+    // called whenever node now spans key depths [start, start + len); path
+    // holds the key characters before start and label the node's edge label
+    void cover(CompressedTrieNode *node, int start, int len, const char *path, const char *label) {
+        if (start >= PREFIX_LEN || start + len < PREFIX_LEN)
+            return;
+
+        char prefix[PREFIX_LEN];
+        for (int k = 0; k < PREFIX_LEN; k++)
+            prefix[k] = k < start ? path[k] : label[k - start];
+
+        int idx = slot(prefix);
+        if (idx >= 0)
+            publish(table[idx], (uintptr_t) node | start);
+    }
+
+    // called before a node that covered its prefix alone is freed
+    void uncover(CompressedTrieNode *node, int start, int len, const char *path, const char *label) {
+        if (start >= PREFIX_LEN || start + len < PREFIX_LEN)
+            return;
+
+        char prefix[PREFIX_LEN];
+        for (int k = 0; k < PREFIX_LEN; k++)
+            prefix[k] = k < start ? path[k] : label[k - start];
+
+        int idx = slot(prefix);
+        if (idx >= 0 && (CompressedTrieNode *) (table[idx] & ~(uintptr_t) 3) == node)
+            publish(table[idx], (uintptr_t) 0);
+    }
+};
+
+#endif
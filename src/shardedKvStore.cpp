@@ -0,0 +1,400 @@
+#ifndef SHARDED_FASTER
+#define SHARDED_FASTER
+
+#include "background.hpp"
+#include "ctrie.hpp"
+#include "getQueue.hpp"
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+// Splits the key space into shardCount independent tries, each behind its
+// own reader-writer lock, so writes to different shards run in parallel.
+// get(key) and multiGet take no lock, like kvStore's.
+// Shards own contiguous ranges of the leading character, which keeps shard
+// order equal to key order: get(N)/del(N) pick the shard from prefix sums
+// of the per-shard entry counts and ask it for the remaining rank.
+// Settings and value lifetimes are the same as for kvStore.
+class shardedKvStore {
+   private:
+    struct shard {
+        CompressedTrie T;
+        pthread_rwlock_t lock;
+    };
+
+    int shardCount;
+    shard *shards;
+    uint8_t shardOf[256];
+    BackgroundTask compactor;
+    GetQueue gets;
+
+    shard &route(const Slice &key) {
+        return shards[shardOf[(uint8_t)key.data[0]]];
+    }
+
+    // locks every shard in index order, so rank queries can't deadlock
+    // against each other
+    void lockAll(bool exclusive) {
+        for (int i = 0; i < shardCount; i++) {
+            if (exclusive)
+                pthread_rwlock_wrlock(&shards[i].lock);
+            else
+                pthread_rwlock_rdlock(&shards[i].lock);
+        }
+    }
+
+    void unlockAll() {
+        for (int i = shardCount - 1; i >= 0; i--)
+            pthread_rwlock_unlock(&shards[i].lock);
+    }
+
+    // maps N (one-indexed, over all shards) to a shard and its local rank,
+    // returns -1 if there are fewer than N entries
+    int locate(int &N) {
+        for (int i = 0; i < shardCount; i++) {
+            int here = shards[i].T.size();
+            if (N <= here)
+                return i;
+            N -= here;
+        }
+        return -1;
+    }
+
+    // orders the non-empty keys of a batch by shard, sorted by key within a
+    // shard if sorted is set and in batch order otherwise; run[i] is where
+    // shard i's keys start in order
+    void group(Slice *keys, int n, bool sorted, vector<int> &order, vector<int> &run) {
+        run.assign(shardCount + 1, 0);
+        if (sorted) {
+            // shard order is key order, so sorting groups the shards too
+            sortBatch(keys, n, order);
+            order.erase(order.begin(), find_if(order.begin(), order.end(),
+                        [keys](int idx) { return keys[idx].size > 0; }));
+            for (int idx : order)
+                run[shardOf[(uint8_t) keys[idx].data[0]] + 1]++;
+        } else {
+            for (int k = 0; k < n; k++)
+                if (keys[k].size)
+                    run[shardOf[(uint8_t) keys[k].data[0]] + 1]++;
+        }
+        for (int i = 0; i < shardCount; i++)
+            run[i + 1] += run[i];
+
+        if (!sorted) {
+            vector<int> next(run.begin(), run.end() - 1);
+            order.resize(run[shardCount]);
+            for (int k = 0; k < n; k++)
+                if (keys[k].size)
+                    order[next[shardOf[(uint8_t) keys[k].data[0]]]++] = k;
+        }
+    }
+
+    void compactStep() {
+        for (int i = 0; i < shardCount; i++) {
+            pthread_rwlock_wrlock(&shards[i].lock);
+            shards[i].T.reclaim();
+            pthread_rwlock_unlock(&shards[i].lock);
+
+            // leaf counts the writes left stale, see kvStore
+            pthread_rwlock_rdlock(&shards[i].lock);
+            shards[i].T.settle();
+            pthread_rwlock_unlock(&shards[i].lock);
+
+            bool more = true;
+            while (more) {
+                pthread_rwlock_wrlock(&shards[i].lock);
+                more = shards[i].T.garbageRatio() > COMPACT_THRESHOLD &&
+                       shards[i].T.compact();
+                pthread_rwlock_unlock(&shards[i].lock);
+            }
+        }
+    }
+
+   public:
+    // shardCount is clamped to [1, 52], one shard per leading [a-zA-Z]
+    explicit shardedKvStore(uint64_t max_entries, int shardCount = 16)
+        : shardCount(shardCount < 1 ? 1 : shardCount > 52 ? 52 : shardCount),
+          gets([this](Slice *keys, Slice *values, bool *found, int n) {
+              multiGet(keys, values, found, n);
+          }) {
+        shards = new shard[this->shardCount];
+        for (int i = 0; i < this->shardCount; i++) {
+            pthread_rwlock_init(&shards[i].lock, NULL);
+            shards[i].T.reserve(max_entries / this->shardCount);
+        }
+
+        // letters are spread evenly in byte order; every other byte goes to
+        // the shard of the closest letter below it, so the map stays monotone
+        int letter = 0, current = 0;
+        for (int c = 0; c < 256; c++) {
+            if (isalpha(c) && c < 128)
+                current = letter++ * this->shardCount / 52;
+            shardOf[c] = current;
+        }
+
+        compactor.start([this] { compactStep(); }, COMPACT_INTERVAL_MS);
+    }
+
+    ~shardedKvStore() {
+        gets.stop();
+        compactor.stop();
+        for (int i = 0; i < shardCount; i++)
+            pthread_rwlock_destroy(&shards[i].lock);
+        delete[] shards;
+    }
+
+    // one jump table per shard, see kvStore::enablePrefixCache
+    void enablePrefixCache() {
+        lockAll(true);
+        for (int i = 0; i < shardCount; i++)
+            shards[i].T.enablePrefixIndex();
+        unlockAll();
+    }
+
+    // summed over the shards, each read under its own lock, see
+    // kvStore::stats
+    TrieStats stats(bool walk = false) {
+        TrieStats s;
+        for (int i = 0; i < shardCount; i++) {
+            pthread_rwlock_rdlock(&shards[i].lock);
+            if (i == 0)
+                s = shards[i].T.stats(walk);
+            else
+                s.add(shards[i].T.stats(walk));
+            pthread_rwlock_unlock(&shards[i].lock);
+        }
+        return s;
+    }
+
+    // returns false if key didn’t exist
+    bool get(Slice &key, Slice &value) {
+        if (key.size == 0)
+            return false;
+        shard &s = route(key);
+        EpochGuard guard(s.T.epochs);
+        return s.T.search(key, value);
+    }
+
+    // see kvStore::getAsync
+    std::future<GetResult> getAsync(const Slice &key) {
+        auto promise = std::make_shared<std::promise<GetResult>>();
+        gets.submit(key, [promise](bool found, Slice value) {
+            promise->set_value({found, value});
+        });
+        return promise->get_future();
+    }
+
+    void getAsync(const Slice &key, GetQueue::Callback done) {
+        gets.submit(key, std::move(done));
+    }
+
+    // returns true if value overwritten
+    bool put(Slice &key, Slice &value) {
+        if (key.size == 0)
+            return false;
+        shard &s = route(key);
+        pthread_rwlock_wrlock(&s.lock);
+        auto result = s.T.insert(key, value);
+        pthread_rwlock_unlock(&s.lock);
+        return result;
+    }
+
+    bool del(Slice &key) {
+        if (key.size == 0)
+            return false;
+        shard &s = route(key);
+        pthread_rwlock_wrlock(&s.lock);
+        auto result = s.T.del(key);
+        pthread_rwlock_unlock(&s.lock);
+        return result;
+    }
+
+    // batched get/put/del, writes with one lock hold per shard, see
+    // kvStore::multiGet
+    int multiGet(Slice *keys, Slice *values, bool *found, int n) {
+        vector<int> order, run;
+        fill(found, found + n, false);
+        group(keys, n, false, order, run);
+        for (int i = 0; i < shardCount; i++) {
+            if (run[i] == run[i + 1])
+                continue;
+            EpochGuard guard(shards[i].T.epochs);
+            shards[i].T.searchBatch(keys, &order[run[i]], run[i + 1] - run[i], values, found);
+        }
+        return count(found, found + n, true);
+    }
+
+    int multiPut(Slice *keys, Slice *values, bool *overwritten, int n) {
+        vector<int> order, run;
+        fill(overwritten, overwritten + n, false);
+        group(keys, n, true, order, run);
+        for (int i = 0; i < shardCount; i++) {
+            if (run[i] == run[i + 1])
+                continue;
+            TrieFinger finger;
+            pthread_rwlock_wrlock(&shards[i].lock);
+            shards[i].T.searchBatch(keys, &order[run[i]], run[i + 1] - run[i], nullptr, nullptr);
+            for (int k = run[i]; k < run[i + 1]; k++)
+                overwritten[order[k]] = shards[i].T.insert(keys[order[k]], values[order[k]], &finger);
+            pthread_rwlock_unlock(&shards[i].lock);
+        }
+        return count(overwritten, overwritten + n, true);
+    }
+
+    int multiDel(Slice *keys, bool *deleted, int n) {
+        vector<int> order, run;
+        fill(deleted, deleted + n, false);
+        group(keys, n, true, order, run);
+        for (int i = 0; i < shardCount; i++) {
+            if (run[i] == run[i + 1])
+                continue;
+            TrieFinger finger;
+            pthread_rwlock_wrlock(&shards[i].lock);
+            shards[i].T.searchBatch(keys, &order[run[i]], run[i + 1] - run[i], nullptr, nullptr);
+            for (int k = run[i]; k < run[i + 1]; k++)
+                deleted[order[k]] = shards[i].T.del(keys[order[k]], &finger);
+            pthread_rwlock_unlock(&shards[i].lock);
+        }
+        return count(deleted, deleted + n, true);
+    }
+
+    // see kvStore::bulkLoad, each shard is sorted and built from its own run
+    // of keys, with up to threads shards at a time
+    bool bulkLoad(Slice *keys, Slice *values, int n, bool sorted = false, int threads = 1) {
+        vector<int> order, run;
+        // batch order within each run, which keeps sorted input sorted
+        group(keys, n, false, order, run);
+        lockAll(true);
+        bool result = true;
+        for (int i = 0; i < shardCount; i++)
+            result = result && shards[i].T.empty();
+        if (result) {
+            vector<std::thread> workers;
+            for (int t = 0; t < max(threads, 1); t++) {
+                workers.emplace_back([&, t] {
+                    for (int i = t; i < shardCount; i += max(threads, 1)) {
+                        int *begin = order.data() + run[i], len = run[i + 1] - run[i];
+                        if (!sorted)
+                            sortBatch(keys, begin, len);
+                        shards[i].T.bulkLoad(keys, values, begin, len);
+                    }
+                });
+            }
+            for (auto &w : workers)
+                w.join();
+        }
+        unlockAll();
+        return result;
+    }
+
+    // Ordered iteration across shards, see kvStore::Cursor. Holds every
+    // shard's read lock for its lifetime.
+    class Cursor {
+        shardedKvStore &kv;
+        char *buffer;
+        int current;
+        TrieCursor cur;
+        // prefix scans stay inside the prefix's shard
+        bool crossShards;
+
+        // moves on to the first key of the following non-empty shard
+        bool advance() {
+            while (crossShards && current + 1 < kv.shardCount) {
+                cur = TrieCursor(&kv.shards[++current].T, buffer);
+                if (cur.seek(Slice(nullptr, 0)))
+                    return true;
+            }
+            return false;
+        }
+
+       public:
+        Cursor(shardedKvStore &kv, char *buffer)
+            : kv(kv), buffer(buffer), current(0), cur(&kv.shards[0].T, buffer), crossShards(true) {
+            kv.lockAll(false);
+        }
+
+        ~Cursor() {
+            kv.unlockAll();
+        }
+
+        Cursor(const Cursor &) = delete;
+
+        Cursor &operator=(const Cursor &) = delete;
+
+        bool seek(const Slice &key) {
+            current = key.size ? kv.shardOf[(uint8_t) key.data[0]] : 0;
+            crossShards = true;
+            cur = TrieCursor(&kv.shards[current].T, buffer);
+            return cur.seek(key) || advance();
+        }
+
+        // N-th (zero-indexed) key
+        bool seek(int N) {
+            int left = N + 1;
+            crossShards = true;
+            current = kv.locate(left);
+            if (current < 0) {
+                current = 0;
+                cur = TrieCursor(&kv.shards[0].T, buffer);
+                return false;
+            }
+            cur = TrieCursor(&kv.shards[current].T, buffer);
+            return cur.seek(left);
+        }
+
+        bool prefixScan(const Slice &prefix) {
+            if (!prefix.size)
+                return seek(prefix);
+            current = kv.shardOf[(uint8_t) prefix.data[0]];
+            crossShards = false;
+            cur = TrieCursor(&kv.shards[current].T, buffer);
+            return cur.prefixScan(prefix);
+        }
+
+        bool next() {
+            if (!cur.valid())
+                return false;
+            return cur.next() || advance();
+        }
+
+        bool valid() const {
+            return cur.valid();
+        }
+
+        Slice key() const {
+            return cur.key();
+        }
+
+        Slice value() const {
+            return cur.value();
+        }
+    };
+
+    // returns Nth (zero-indexed) key-value pair
+    bool get(int N, Slice &key, Slice &value) {
+        int left = N + 1;
+        bool result = false;
+        lockAll(false);
+        int idx = locate(left);
+        if (idx >= 0)
+            result = shards[idx].T.search(left, key, value);
+        unlockAll();
+        return result;
+    }
+
+    // delete Nth (zero-indexed) key-value pair
+    bool del(int N) {
+        int left = N + 1;
+        bool result = false;
+        lockAll(true);
+        int idx = locate(left);
+        if (idx >= 0)
+            result = shards[idx].T.del(left);
+        unlockAll();
+        return result;
+    }
+};
+#endif
@@ -0,0 +1,202 @@
+#include "snapshot.hpp"
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static const char SNAPSHOT_MAGIC[8] = {'F', 'M', 'S', 'N', 'A', 'P', '1', 0};
+
+static uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+// makes a rename in path's directory durable
+static bool syncDirectory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    string dir = slash ? string(path, slash - path + 1) : ".";
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool writeSnapshot(CompressedTrie &T, const char *path, uint64_t logPosition) {
+    ValueLog &log = T.arena->log;
+    T.settle();
+
+    // breadth first, so each node's children get consecutive indices
+    vector<CompressedTrieNode *> order(1, T.root);
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i]->sucs.forEach([&order](CompressedTrieNode *kid) {
+            order.push_back(kid);
+            return false;
+        });
+    }
+
+    // written next to path and renamed over it once complete, so a crash
+    // leaves either the old snapshot or the new one
+    string tmp = string(path) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.nodeCount = order.size();
+    header.logPosition = logPosition;
+    header.nodesOffset = sizeof(SnapshotHeader);
+    header.keysOffset = header.nodesOffset + order.size() * sizeof(SnapshotNode);
+    header.blobOffset = align8(header.keysOffset + order.size());
+    fwrite(&header, sizeof(header), 1, f);
+
+    uint64_t blobSize = 0;
+    uint32_t nextChild = 1;
+    for (CompressedTrieNode *node : order) {
+        SnapshotNode rec = {};
+        rec.label = blobSize;
+        rec.labelSize = node->edgeLabelSize;
+        blobSize += node->edgeLabelSize;
+        if (node->isLeaf) {
+            rec.isLeaf = 1;
+            rec.value = blobSize;
+            rec.valueSize = log.header(node->value)->size;
+            // values keep their NUL like in the log
+            blobSize += rec.valueSize + 1;
+        }
+        rec.numLeafs = node->num_leafs;
+        rec.childCount = node->sucs.size();
+        rec.firstChild = nextChild;
+        nextChild += rec.childCount;
+        fwrite(&rec, sizeof(rec), 1, f);
+    }
+
+    for (CompressedTrieNode *node : order)
+        fputc(node->edgeKey, f);
+    for (uint64_t pad = header.keysOffset + order.size(); pad < header.blobOffset; pad++)
+        fputc(0, f);
+
+    char scratch[256];
+    for (CompressedTrieNode *node : order) {
+        fwrite(labelOf(log, node, scratch), 1, node->edgeLabelSize, f);
+        if (node->isLeaf)
+            fwrite(log.at(node->value), 1, log.header(node->value)->size + 1, f);
+    }
+
+    header.blobSize = blobSize;
+    fseek(f, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    // on disk before a checkpoint lets the write-ahead log go
+    bool ok = !ferror(f) && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0 || !ok || rename(tmp.c_str(), path) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return syncDirectory(path);
+}
+
+Snapshot::Snapshot()
+        : base(nullptr), bytes(0), header(nullptr), nodes(nullptr), keys(nullptr), blob(nullptr) {}
+
+Snapshot::~Snapshot() {
+    if (base)
+        munmap(base, bytes);
+}
+
+bool Snapshot::open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    auto h = (const SnapshotHeader *) map;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) || h->nodeCount == 0 ||
+        h->blobOffset + h->blobSize > (uint64_t) st.st_size) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    // lookups jump around, readahead would mostly fetch unused pages
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    if (base)
+        munmap(base, bytes);
+    base = (char *) map;
+    bytes = st.st_size;
+    header = h;
+    nodes = (const SnapshotNode *) (base + h->nodesOffset);
+    keys = (const uint8_t *) (base + h->keysOffset);
+    blob = base + h->blobOffset;
+    return true;
+}
+
+const SnapshotNode *Snapshot::child(const SnapshotNode *node, uint8_t c) const {
+    int lo = node->firstChild, hi = node->firstChild + node->childCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (keys[mid] < c)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < (int) (node->firstChild + node->childCount) && keys[lo] == c ? nodes + lo : nullptr;
+}
+
+bool Snapshot::search(const Slice &key, Slice &value) const {
+    const SnapshotNode *node = nodes;
+    int i = 0;
+    while (i < key.size) {
+        node = child(node, key.data[i]);
+        if (!node || node->labelSize > key.size - i ||
+            memcmp(blob + node->label, key.data + i, node->labelSize))
+            return false;
+        i += node->labelSize;
+    }
+    if (!node->isLeaf)
+        return false;
+    value.data = (char *) blob + node->value;
+    value.size = node->valueSize;
+    return true;
+}
+
+bool Snapshot::search(int N, Slice &key, Slice &value) const {
+    if (N < 1 || N > size())
+        return false;
+
+    char *buffer = (char *) malloc(256);
+    int depth = 0;
+    const SnapshotNode *node = nodes;
+    while (true) {
+        // the child whose subtree holds the N-th leaf
+        const SnapshotNode *kid = nodes + node->firstChild;
+        while (N > (int) kid->numLeafs) {
+            N -= kid->numLeafs;
+            kid++;
+        }
+        memcpy(buffer + depth, blob + kid->label, kid->labelSize);
+        depth += kid->labelSize;
+        if (kid->isLeaf && --N == 0) {
+            key.data = buffer;
+            key.size = depth;
+            value.data = (char *) blob + kid->value;
+            value.size = kid->valueSize;
+            return true;
+        }
+        node = kid;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef snapshot_h
+#define snapshot_h
+
+#include "ctrie.hpp"
+#include <cstdint>
+#include <cstring>
+
+// On-disk image of a trie that can be mapped and searched in place:
+//
+//   SnapshotHeader
+//   SnapshotNode[nodeCount]   breadth first, so the children of a node are
+//                             consecutive records starting at firstChild
+//   uint8_t[nodeCount]        first label byte of every node, binary
+//                             searched when picking a child
+//   blob                      labels and values, addressed by offset
+//
+// Everything is addressed by index or offset, so opening a snapshot is a
+// single mmap and lookups fault in only the pages they touch.
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t nodeCount;
+    uint64_t nodesOffset;
+    uint64_t keysOffset;
+    uint64_t blobOffset;
+    uint64_t blobSize;
+    // write-ahead log position the snapshot includes everything before
+    uint64_t logPosition;
+};
+
+struct SnapshotNode {
+    uint64_t label;
+    uint64_t value;
+    uint32_t firstChild;
+    uint32_t numLeafs;
+    uint32_t valueSize;
+    uint16_t childCount;
+    uint8_t labelSize;
+    uint8_t isLeaf;
+};
+
+// writes T to path.tmp and renames it over path, returns false on I/O errors
+bool writeSnapshot(CompressedTrie &T, const char *path, uint64_t logPosition = 0);
+
+// Read-only view of a mapped snapshot. Slices returned by search point into
+// the mapping, which stays until the Snapshot is destroyed.
+class Snapshot {
+    char *base;
+    size_t bytes;
+    const SnapshotHeader *header;
+    const SnapshotNode *nodes;
+    const uint8_t *keys;
+    const char *blob;
+
+    const SnapshotNode *child(const SnapshotNode *node, uint8_t c) const;
+
+public:
+    Snapshot();
+
+    ~Snapshot();
+
+    Snapshot(const Snapshot &) = delete;
+
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    // maps path, false if it can't be read or isn't a snapshot
+    bool open(const char *path);
+
+    int size() const {
+        return nodes[0].numLeafs;
+    }
+
+    uint64_t logPosition() const {
+        return header->logPosition;
+    }
+
+    size_t mappedBytes() const {
+        return bytes;
+    }
+
+    bool search(const Slice &key, Slice &value) const;
+
+    // N-th key (one-indexed), the key is malloc'd like CompressedTrie's
+    bool search(int N, Slice &key, Slice &value) const;
+
+    // calls f(key, value) for every entry in key order
+    template<typename F>
+    void forEach(F f) const;
+
+private:
+    template<typename F>
+    void walk(const SnapshotNode *node, char *key, int depth, F &f) const;
+};
+
+template<typename F>
+void Snapshot::forEach(F f) const {
+    char key[256];
+    walk(nodes, key, 0, f);
+}
+
+template<typename F>
+void Snapshot::walk(const SnapshotNode *node, char *key, int depth, F &f) const {
+    if (node->isLeaf)
+        f(Slice(key, depth), Slice((char *) blob + node->value, node->valueSize));
+    for (int i = 0; i < node->childCount; i++) {
+        const SnapshotNode *kid = nodes + node->firstChild + i;
+        memcpy(key + depth, blob + kid->label, kid->labelSize);
+        walk(kid, key, depth + kid->labelSize, f);
+    }
+}
+
+#endif
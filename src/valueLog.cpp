@@ -0,0 +1,130 @@
+#include "valueLog.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+ValueLog::ValueLog(uint32_t segmentBytes)
+        : active(0), segmentBytes(segmentBytes), usedBytes(0), deadBytes(0) {
+    segments.reserve(LOG_MAX_SEGMENTS);
+    openSegment();
+}
+
+// dropped segments are still in segments
+ValueLog::~ValueLog() {
+    for (auto &s : segments)
+        free(s.data);
+}
+
+void ValueLog::openSegment() {
+    Segment s = {(char *) malloc(segmentBytes), 0, 0};
+    if (!s.data)
+        throw std::bad_alloc();
+
+    if (!freeSlots.empty()) {
+        active = freeSlots.back();
+        freeSlots.pop_back();
+        segments[active] = s;
+    } else {
+        if (segments.size() == segments.capacity()) {
+            free(s.data);
+            throw std::bad_alloc();
+        }
+        active = segments.size();
+        segments.push_back(s);
+    }
+}
+
+LogRef ValueLog::append(CompressedTrieNode *owner, LogKind kind, const char *data, uint32_t size) {
+    uint32_t bytes = recordBytes(size);
+    if (segments[active].used + bytes > segmentBytes)
+        openSegment();
+
+    Segment &s = segments[active];
+    auto rec = (LogRecord *) (s.data + s.used);
+    rec->owner = owner;
+    rec->size = size;
+    rec->kind = kind;
+    char *dst = (char *) (rec + 1);
+    memcpy(dst, data, size);
+    dst[size] = 0;
+
+    LogRef ref = ((LogRef) active << 32) | (s.used + sizeof(LogRecord));
+    s.used += bytes;
+    usedBytes += bytes;
+    return ref;
+}
+
+void ValueLog::release(LogRef ref) {
+    if (!ref) return;
+    // compact() must not mistake it for live through a node that is
+    // retired but not yet reused
+    header(ref)->owner = nullptr;
+    uint32_t bytes = recordBytes(header(ref)->size);
+    segments[ref >> 32].dead += bytes;
+    deadBytes += bytes;
+}
+
+double ValueLog::garbageRatio() const {
+    return usedBytes ? (double) deadBytes / usedBytes : 0;
+}
+
+int ValueLog::victim() const {
+    int best = -1;
+    uint32_t most = 0;
+    for (uint32_t i = 0; i < segments.size(); i++) {
+        if (i == active || !segments[i].data)
+            continue;
+        if (segments[i].dead > most) {
+            most = segments[i].dead;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// readers may still resolve old refs into seg, so neither its memory nor
+// its slot can be reused yet; with used and dead zeroed it is never a victim
+void ValueLog::drop(int seg, uint64_t epoch) {
+    Segment &s = segments[seg];
+    usedBytes -= s.used;
+    deadBytes -= s.dead;
+    s.used = s.dead = 0;
+    retired.push_back({(uint32_t) seg, epoch});
+}
+
+void ValueLog::reclaim(uint64_t safe) {
+    size_t kept = 0;
+    for (auto &r : retired) {
+        if (r.epoch >= safe) {
+            retired[kept++] = r;
+            continue;
+        }
+        free(segments[r.seg].data);
+        segments[r.seg].data = nullptr;
+        freeSlots.push_back(r.seg);
+    }
+    retired.resize(kept);
+}
+
+LogRef ValueLog::absorb(ValueLog &other) {
+    LogRef base = segments.size();
+    if (base + other.segments.size() > segments.capacity())
+        throw std::bad_alloc();
+    segments.insert(segments.end(), other.segments.begin(), other.segments.end());
+    for (uint32_t slot : other.freeSlots)
+        freeSlots.push_back(base + slot);
+    for (auto r : other.retired)
+        retired.push_back({(uint32_t) (base + r.seg), r.epoch});
+    usedBytes += other.usedBytes;
+    deadBytes += other.deadBytes;
+
+    other.segments.clear();
+    other.freeSlots.clear();
+    other.retired.clear();
+    other.usedBytes = other.deadBytes = 0;
+    return base << 32;
+}
+
+uint64_t ValueLog::reservedBytes() const {
+    return (uint64_t) (segments.size() - freeSlots.size()) * segmentBytes;
+}
@@ -0,0 +1,139 @@
+#ifndef value_log_h
+#define value_log_h
+
+#include <cstdint>
+#include <vector>
+
+struct CompressedTrieNode;
+
+// (segment << 32) | offset of the record's data, 0 means no record
+typedef uint64_t LogRef;
+
+enum LogKind : uint8_t { LOG_LABEL, LOG_VALUE };
+
+// Header in front of every record. The owner lets the compactor find the
+// node still referencing a record without walking the trie.
+struct LogRecord {
+    CompressedTrieNode *owner;
+    uint32_t size;
+    uint8_t kind;
+};
+
+#ifndef LOG_SEGMENT_BYTES
+#define LOG_SEGMENT_BYTES (4 << 20)
+#endif
+
+// the stores' compactor wakes up every COMPACT_INTERVAL_MS and rewrites
+// segments while more than COMPACT_THRESHOLD of the log is dead
+#ifndef COMPACT_INTERVAL_MS
+#define COMPACT_INTERVAL_MS 100
+#endif
+#ifndef COMPACT_THRESHOLD
+#define COMPACT_THRESHOLD 0.3
+#endif
+// segments a log can address; the table is reserved up front so lock-free
+// readers can index it while the writer opens segments
+#ifndef LOG_MAX_SEGMENTS
+#define LOG_MAX_SEGMENTS (1 << 18)
+#endif
+
+// Append-only storage for edge labels and values. Records are bump
+// allocated in large segments and never rewritten apart from their owner;
+// overwrites and deletes only mark them dead. Once enough of a segment is
+// dead, compaction copies its live records to the active segment and frees
+// it.
+class ValueLog {
+    struct Segment {
+        char *data;
+        uint32_t used;
+        uint32_t dead;
+    };
+
+    // a dropped segment and the reclamation epoch it was dropped in
+    struct Retired {
+        uint32_t seg;
+        uint64_t epoch;
+    };
+
+    std::vector<Segment> segments;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Retired> retired;
+    uint32_t active;
+    uint32_t segmentBytes;
+    uint64_t usedBytes, deadBytes;
+
+    void openSegment();
+
+public:
+    explicit ValueLog(uint32_t segmentBytes = LOG_SEGMENT_BYTES);
+
+    ~ValueLog();
+
+    ValueLog(const ValueLog &) = delete;
+
+    ValueLog &operator=(const ValueLog &) = delete;
+
+    // copies size bytes of data, values are also NUL terminated
+    LogRef append(CompressedTrieNode *owner, LogKind kind, const char *data, uint32_t size);
+
+    char *at(LogRef ref) const {
+        return segments[ref >> 32].data + (uint32_t) ref;
+    }
+
+    LogRecord *header(LogRef ref) const {
+        return (LogRecord *) at(ref) - 1;
+    }
+
+    // the record is no longer referenced by its owner, which is forgotten
+    void release(LogRef ref);
+
+    // dead bytes over all bytes written to segments that are still held
+    double garbageRatio() const;
+
+    // the sealed segment with the most dead bytes, -1 if there is none
+    int victim() const;
+
+    // calls f(ref, record) for every record in segment seg
+    template<typename F>
+    void forEachRecord(int seg, F f) const;
+
+    // retires a segment whose live records have all been moved elsewhere in
+    // epoch; its memory stays readable, and its slot unused, until reclaim()
+    void drop(int seg, uint64_t epoch);
+
+    // frees the segments dropped before epoch safe
+    void reclaim(uint64_t safe);
+
+    // Takes over the segments of other, which is left empty, and returns
+    // what to add to other's refs to address the same records here.
+    LogRef absorb(ValueLog &other);
+
+    uint64_t liveBytes() const {
+        return usedBytes - deadBytes;
+    }
+
+    uint64_t garbageBytes() const {
+        return deadBytes;
+    }
+
+    uint64_t reservedBytes() const;
+};
+
+static inline uint32_t recordBytes(uint32_t size) {
+    // header + data + NUL, rounded up to keep headers aligned
+    return (sizeof(LogRecord) + size + 1 + 7) & ~7u;
+}
+
+template<typename F>
+void ValueLog::forEachRecord(int seg, F f) const {
+    // by value: f may append to the active segment
+    const Segment s = segments[seg];
+    uint32_t off = 0;
+    while (off < s.used) {
+        auto rec = (LogRecord *) (s.data + off);
+        f(((LogRef) seg << 32) | (off + sizeof(LogRecord)), rec);
+        off += recordBytes(rec->size);
+    }
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include "wal.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// FNV-1a, enough to tell a torn tail from a record
+static uint32_t checksum(const char *data, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ (uint8_t) data[i]) * 16777619u;
+    return h;
+}
+
+// a write the log already acknowledged can't be taken back, so I/O errors
+// past open() end the process
+static void fail(const char *what) {
+    perror(what);
+    abort();
+}
+
+static void writeAll(int fd, const char *data, size_t n) {
+    while (n) {
+        ssize_t done = write(fd, data, n);
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            fail("wal write");
+        }
+        data += done;
+        n -= done;
+    }
+}
+
+WriteAheadLog::WriteAheadLog()
+        : fd(-1), policy(SYNC_BATCH), appended(0), written(0), fileBytes(0), flushing(false) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&flushed, NULL);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    syncer.stop();
+    if (fd >= 0) {
+        commit(appended);
+        fdatasync(fd);
+        close(fd);
+    }
+    pthread_cond_destroy(&flushed);
+    pthread_mutex_destroy(&mutex);
+}
+
+bool WriteAheadLog::open(const char *path, SyncPolicy syncPolicy, uint64_t covered, const Apply &apply) {
+    int f = ::open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (f < 0)
+        return false;
+    struct stat st;
+    if (fstat(f, &st) < 0) {
+        close(f);
+        return false;
+    }
+
+    // a new file, or one emptied by a checkpoint that crashed before
+    // writing the start back, begins where the snapshot ends
+    uint64_t start = covered, valid = 0;
+    if (st.st_size >= WAL_START_BYTES) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, f, 0);
+        if (map == MAP_FAILED) {
+            close(f);
+            return false;
+        }
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        char *data = (char *) map;
+        memcpy(&start, data, WAL_START_BYTES);
+        uint64_t at = WAL_START_BYTES;
+        while (at + WAL_HEADER_BYTES <= (uint64_t) st.st_size) {
+            char *rec = data + at;
+            uint32_t sum, arg;
+            memcpy(&sum, rec, 4);
+            memcpy(&arg, rec + 6, 4);
+            WalOp op = (WalOp) rec[4];
+            uint8_t keySize = rec[5];
+            uint64_t valueSize = op == WAL_PUT ? arg : 0;
+            uint64_t end = at + WAL_HEADER_BYTES + keySize + valueSize;
+            if (op < WAL_PUT || op > WAL_DEL_N || end > (uint64_t) st.st_size ||
+                checksum(rec + 4, end - at - 4) != sum)
+                break;
+            // a checkpoint that crashed before emptying the log leaves
+            // records the snapshot already has
+            if (start + end - WAL_START_BYTES > covered) {
+                char *key = rec + WAL_HEADER_BYTES;
+                apply(op, Slice(key, keySize), Slice(key + keySize, valueSize), arg);
+            }
+            at = end;
+        }
+        munmap(map, st.st_size);
+        valid = at - WAL_START_BYTES;
+    }
+
+    bool ok;
+    if (st.st_size < WAL_START_BYTES) {
+        ok = ftruncate(f, 0) == 0 && write(f, &start, WAL_START_BYTES) == WAL_START_BYTES;
+    } else {
+        // a crash mid-append leaves a partial record, later appends go
+        // after the intact ones
+        ok = WAL_START_BYTES + valid == (uint64_t) st.st_size || ftruncate(f, WAL_START_BYTES + valid) == 0;
+    }
+    if (!ok) {
+        close(f);
+        return false;
+    }
+
+    fd = f;
+    policy = syncPolicy;
+    appended = written = start + valid;
+    fileBytes = valid;
+    if (policy == SYNC_INTERVAL) {
+        syncer.start([this] {
+            fdatasync(fd);
+        }, WAL_SYNC_INTERVAL_MS);
+    }
+    return true;
+}
+
+uint64_t WriteAheadLog::append(WalOp op, const Slice &key, const Slice &value, int N) {
+    uint32_t arg = op == WAL_PUT ? value.size : op == WAL_DEL_N ? N : 0;
+    uint8_t keySize = op == WAL_DEL_N ? 0 : key.size;
+    char header[WAL_HEADER_BYTES];
+    header[4] = op;
+    header[5] = keySize;
+    memcpy(header + 6, &arg, 4);
+
+    pthread_mutex_lock(&mutex);
+    size_t at = pending.size();
+    pending.append(header, WAL_HEADER_BYTES);
+    if (keySize)
+        pending.append(key.data, keySize);
+    if (op == WAL_PUT)
+        pending.append(value.data, value.size);
+    char *rec = &pending[at];
+    uint32_t sum = checksum(rec + 4, pending.size() - at - 4);
+    memcpy(rec, &sum, 4);
+    appended += pending.size() - at;
+    uint64_t ticket = appended;
+    pthread_mutex_unlock(&mutex);
+    return ticket;
+}
+
+void WriteAheadLog::commit(uint64_t ticket) {
+    string batch;
+    pthread_mutex_lock(&mutex);
+    while (written < ticket) {
+        if (flushing) {
+            pthread_cond_wait(&flushed, &mutex);
+            continue;
+        }
+        // lead this round: everything buffered goes out in one write
+        flushing = true;
+        batch.clear();
+        batch.swap(pending);
+        uint64_t upto = appended;
+        pthread_mutex_unlock(&mutex);
+
+        writeAll(fd, batch.data(), batch.size());
+        if (policy == SYNC_BATCH && fdatasync(fd) < 0)
+            fail("wal fdatasync");
+
+        pthread_mutex_lock(&mutex);
+        written = upto;
+        fileBytes += batch.size();
+        flushing = false;
+        pthread_cond_broadcast(&flushed);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void WriteAheadLog::truncate() {
+    pthread_mutex_lock(&mutex);
+    while (flushing)
+        pthread_cond_wait(&flushed, &mutex);
+    pending.clear();
+    written = appended;
+    if (ftruncate(fd, 0) < 0)
+        fail("wal truncate");
+    writeAll(fd, (char *) &appended, WAL_START_BYTES);
+    fileBytes = 0;
+    pthread_cond_broadcast(&flushed);
+    pthread_mutex_unlock(&mutex);
+}
+
+uint64_t WriteAheadLog::position() {
+    pthread_mutex_lock(&mutex);
+    uint64_t at = appended;
+    pthread_mutex_unlock(&mutex);
+    return at;
+}
+
+uint64_t WriteAheadLog::size() {
+    pthread_mutex_lock(&mutex);
+    uint64_t bytes = fileBytes + pending.size();
+    pthread_mutex_unlock(&mutex);
+    return bytes;
+}
@@ -0,0 +1,92 @@
+#ifndef wal_h
+#define wal_h
+
+#include "background.hpp"
+#include "ctrie.hpp"
+#include <cstdint>
+#include <functional>
+#include <pthread.h>
+#include <string>
+
+// how often SYNC_INTERVAL flushes the log to disk
+#ifndef WAL_SYNC_INTERVAL_MS
+#define WAL_SYNC_INTERVAL_MS 10
+#endif
+// log size at which the store writes a snapshot and empties the log
+#ifndef WAL_CHECKPOINT_BYTES
+#define WAL_CHECKPOINT_BYTES (64 << 20)
+#endif
+
+// When a write returns:
+//   SYNC_NONE      its record was handed to the OS, surviving a crash of the
+//                  process but not of the machine
+//   SYNC_INTERVAL  the same, and a background thread syncs the log every
+//                  WAL_SYNC_INTERVAL_MS, so at most that much is lost
+//   SYNC_BATCH     its record is on disk
+enum SyncPolicy { SYNC_NONE, SYNC_INTERVAL, SYNC_BATCH };
+
+enum WalOp : uint8_t { WAL_PUT = 1, WAL_DEL, WAL_DEL_N };
+
+// The file starts with the uint64 position of its first record, counted in
+// bytes ever logged; a snapshot stores the position it covers up to. Every
+// record is a 10 byte header followed by the key and the value:
+//   uint32 checksum of everything after it | uint8 op | uint8 key size |
+//   uint32 value size, or N for WAL_DEL_N
+// Replay stops at the first torn or corrupt record and cuts the log there.
+#define WAL_START_BYTES 8
+#define WAL_HEADER_BYTES 10
+
+// Records are appended to a memory buffer while the store holds its write
+// lock, so the log order is the order writes were applied. commit() then
+// waits outside the lock: the first waiter writes (and under SYNC_BATCH
+// syncs) everything buffered so far, and writers arriving meanwhile queue
+// up for the next round, so concurrent writers share one fdatasync.
+class WriteAheadLog {
+public:
+    typedef std::function<void(WalOp op, const Slice &key, const Slice &value, int N)> Apply;
+
+private:
+    int fd;
+    SyncPolicy policy;
+    pthread_mutex_t mutex;
+    pthread_cond_t flushed;
+    std::string pending;
+    // positions appended and written up to, tickets count in these
+    uint64_t appended, written;
+    // bytes of records in the file since it was last emptied
+    uint64_t fileBytes;
+    bool flushing;
+    BackgroundTask syncer;
+
+public:
+    WriteAheadLog();
+
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    // Calls apply for every intact record of path in log order, skipping
+    // those before position covered (which a snapshot already holds), then
+    // keeps the file open for appending. False if it can't be opened.
+    bool open(const char *path, SyncPolicy policy, uint64_t covered, const Apply &apply);
+
+    // returns the ticket to commit once the store's lock is released
+    uint64_t append(WalOp op, const Slice &key, const Slice &value, int N = 0);
+
+    // waits until every record up to ticket is as durable as the policy
+    // promises
+    void commit(uint64_t ticket);
+
+    // Drops everything logged so far, after a snapshot made it redundant.
+    // The store's write lock must be held, so nothing is appended meanwhile.
+    void truncate();
+
+    // where the next record goes, what a snapshot taken now covers
+    uint64_t position();
+
+    uint64_t size();
+};
+
+#endif
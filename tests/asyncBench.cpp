@@ -0,0 +1,68 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// one frontend thread issuing lookups: blocking get() against getAsync()
+// with callbacks and with futures, keeping up to IN_FLIGHT requests queued
+#define LOOKUPS 1000000
+#define IN_FLIGHT 1024
+
+int main() {
+    unsigned seed = 0;
+    kvStore kv(SEED);
+    vector<string> keys = randomKeys(seed, SEED);
+    preload(kv, keys);
+
+    vector<Slice> lookups;
+    for (int i = 0; i < LOOKUPS; i++) {
+        string &k = keys[rand_r(&seed) % keys.size()];
+        lookups.push_back(Slice(&k[0], k.size()));
+    }
+
+    struct timespec st, en;
+    printf("mode,ops_s,found\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    long found = 0;
+    for (auto &key : lookups) {
+        Slice val;
+        found += kv.get(key, val);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("get,%.0lf,%ld\n", LOOKUPS / (timer(en) - timer(st)), found);
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    atomic<long> done(0), hits(0);
+    for (int i = 0; i < LOOKUPS; i++) {
+        while (i - done.load() >= IN_FLIGHT)
+            sched_yield();
+        kv.getAsync(lookups[i], [&](bool f, Slice val) {
+            hits += f;
+            done++;
+        });
+    }
+    while (done.load() < LOOKUPS)
+        sched_yield();
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("getAsync_callback,%.0lf,%ld\n", LOOKUPS / (timer(en) - timer(st)), hits.load());
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    found = 0;
+    deque<future<GetResult>> inFlight;
+    for (int i = 0; i < LOOKUPS; i++) {
+        if (inFlight.size() == IN_FLIGHT) {
+            found += inFlight.front().get().found;
+            inFlight.pop_front();
+        }
+        inFlight.push_back(kv.getAsync(lookups[i]));
+    }
+    for (auto &f : inFlight)
+        found += f.get().found;
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("getAsync_future,%.0lf,%ld\n", LOOKUPS / (timer(en) - timer(st)), found);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// compares single-key get/put/del against multiGet/multiPut/multiDel on
+// keys that overlap like tests/generator.cpp's PREFIX_OVERLAP mode
+#define OPS 1000000
+#define BATCH_SIZE 256
+#define CLUSTER_WINDOW 4096
+#define REPEAT 4
+
+vector<Slice> keys, sortedKeys;
+
+// seconds spent in op over OPS existing keys, BATCH_SIZE per call. With
+// clustered set, each batch comes from a window of neighbouring keys, like
+// requests for related keys sharing long prefixes.
+template<typename F>
+double run(F op, bool clustered) {
+    unsigned seed = 7;
+    vector<Slice> batch(BATCH_SIZE), values(BATCH_SIZE);
+    unique_ptr<bool[]> results(new bool[BATCH_SIZE]);
+    struct timespec st, en;
+    double total = 0;
+
+    for (int done = 0; done < OPS; done += BATCH_SIZE) {
+        int window = rand_r(&seed) % (keys.size() - CLUSTER_WINDOW);
+        for (auto &k : batch) {
+            if (clustered)
+                k = sortedKeys[window + rand_r(&seed) % CLUSTER_WINDOW];
+            else
+                k = keys[rand_r(&seed) % keys.size()];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &st);
+        op(batch.data(), values.data(), results.get());
+        clock_gettime(CLOCK_MONOTONIC, &en);
+        total += timer(en) - timer(st);
+    }
+    return total;
+}
+
+// ops/s of single and batched, alternating which one runs first so the
+// compactor and cache warmup don't favour either
+template<typename F, typename G>
+void compare(const char *label, bool clustered, F single, G batched) {
+    double singleTime = 0, batchedTime = 0;
+    for (int r = 0; r < REPEAT; r++) {
+        if (r % 2) {
+            batchedTime += run(batched, clustered);
+            singleTime += run(single, clustered);
+        } else {
+            singleTime += run(single, clustered);
+            batchedTime += run(batched, clustered);
+        }
+    }
+    printf("%s,%s,%.0lf,%.0lf\n", label, clustered ? "clustered" : "random",
+           REPEAT * OPS / singleTime, REPEAT * OPS / batchedTime);
+}
+
+int main() {
+    unsigned seed = 0;
+    kvStore kv(SEED);
+    Slice v = benchValue();
+
+    for (int i = 0; i < SEED; i++) {
+        keys.push_back(overlappingKey(seed, keys));
+        kv.put(keys.back(), v);
+    }
+
+    sortedKeys = keys;
+    sort(sortedKeys.begin(), sortedKeys.end(), [](const Slice &a, const Slice &b) {
+        int cmp = memcmp(a.data, b.data, min(a.size, b.size));
+        return cmp ? cmp < 0 : a.size < b.size;
+    });
+
+    printf("op,batches,single_ops_s,batched_ops_s\n");
+    for (bool clustered : {false, true}) {
+        compare("get", clustered, [&](Slice *k, Slice *vals, bool *r) {
+            for (int i = 0; i < BATCH_SIZE; i++)
+                r[i] = kv.get(k[i], vals[i]);
+        }, [&](Slice *k, Slice *vals, bool *r) {
+            kv.multiGet(k, vals, r, BATCH_SIZE);
+        });
+        compare("put", clustered, [&](Slice *k, Slice *vals, bool *r) {
+            for (int i = 0; i < BATCH_SIZE; i++)
+                r[i] = kv.put(k[i], v);
+        }, [&](Slice *k, Slice *vals, bool *r) {
+            for (int i = 0; i < BATCH_SIZE; i++)
+                vals[i] = v;
+            kv.multiPut(k, vals, r, BATCH_SIZE);
+        });
+    }
+
+    // deletes remove keys for good, so each variant gets its own half and
+    // only random batches are measured
+    random_shuffle(keys.begin(), keys.end());
+    vector<Slice> all;
+    all.swap(keys);
+    keys.assign(all.begin(), all.begin() + all.size() / 2);
+    double single = run([&](Slice *k, Slice *vals, bool *r) {
+        for (int i = 0; i < BATCH_SIZE; i++)
+            r[i] = kv.del(k[i]);
+    }, false);
+    keys.assign(all.begin() + all.size() / 2, all.end());
+    double batched = run([&](Slice *k, Slice *vals, bool *r) {
+        kv.multiDel(k, r, BATCH_SIZE);
+    }, false);
+    printf("del,random,%.0lf,%.0lf\n", OPS / single, OPS / batched);
+
+    return 0;
+}
@@ -4,9 +4,11 @@
 #include <time.h>
 #include "kvStore.cpp"
 
+#define SEED 10000
+#include "workload.hpp"
+
 using namespace std;
  #define TIME_INSERTS
-//#define MULTITHREAD_TEST
 
 string sliceToStr(Slice &a) {
     string ret = "";
@@ -25,13 +27,8 @@ void strToSlice(const string& l, Slice &a) {
 
 string random_key(int stringLength) {
     string k;
-    string letters = "";
-    for (char i = 'a'; i <= 'z'; i++)
-        letters += i;
-    for (char i = 'A'; i <= 'Z'; i++)
-        letters += i;
     for (int i = 0; i < stringLength; i++)
-        k = k + letters[rand() % 52];
+        k = k + alpha[rand() % 52];
 
     return k;
 }
@@ -52,72 +49,10 @@ string random_value(int stringLength) {
     return v;
 }
 
-long CLOCKS_PER_SECOND = 1000000;
 kvStore kv(10000000);
 map<string, string> db;
 long long db_size = 0;
 
-void *myThreadFun(void *vargp) {
-    int transactions = 0;
-    clock_t start = clock();
-    int time = 10;
-    clock_t tt = clock();
-    while ((float(tt - start) / CLOCKS_PER_SECOND) <= time) {
-        for (int i = 0; i < 10000; i++) {
-            transactions += 1;
-            int x = rand() % 5;
-            if (x == 0) {
-                string key = random_key(rand() % 64 + 1);
-                Slice s_key, s_value;
-                strToSlice(key, s_key);
-                bool ans = kv.get(s_key, s_value);
-            } else if (x == 1) {
-                string key = random_key(rand() % 64 + 1);
-                string value = random_value(rand() % 255 + 1);
-                Slice s_key, s_value, temp;
-                strToSlice(key, s_key);
-                strToSlice(value, s_value);
-
-                bool check = kv.get(s_key, temp);
-                bool ans = kv.put(s_key, s_value);
-
-                if (check == false)
-                    db_size++;
-            } else if (x == 2) {
-                int temp = db_size;
-                if (temp == 0)
-                    continue;
-                int rem = rand() % temp;
-                Slice s_key, s_value;
-                bool check = kv.get(rem, s_key, s_value);
-                check = kv.del(s_key);
-                db_size--;
-            } else if (x == 3) {
-                int temp = db_size;
-                if (temp == 0)
-                    continue;
-                int rem = rand() % temp;
-                Slice s_key, s_value;
-                bool check = kv.get(rem, s_key, s_value);
-            } else if (x == 4) {
-                int temp = db_size;
-                if (temp == 0)
-                    continue;
-                int rem = rand() % temp;
-                bool check = kv.del(rem);
-                db_size--;
-            }
-        }
-        tt = clock();
-    }
-    cout << transactions / time << endl;
-    return NULL;
-}
-
-inline double timer(struct timespec &t) {
-    return t.tv_nsec / 1e9 + t.tv_sec;
-}
-
 int main() {
     srand(0);
 
@@ -127,11 +62,6 @@ int main() {
     double sst, een;
 #endif
 
-    int SEED = 1e4;
-#ifdef MULTITHREAD_TEST
-    SEED = 0;
-#endif
-
     for (int i = 0; i < SEED; i++) {
         string key = random_key(rand() % 64 + 1);
         string value = random_value(rand() % 255 + 1);
@@ -150,8 +80,6 @@ int main() {
         totalTime += een - sst;
 #endif
         db_size = db.size();
-        printf("\033[2J");
-        printf("%d\n", i);
     }
 #ifdef TIME_INSERTS
     clock_gettime(CLOCK_MONOTONIC_RAW, &en);
@@ -163,9 +91,6 @@ int main() {
     bool incorrect = false;
 
     int lim = 1e5;
-#ifdef MULTITHREAD_TEST
-    lim = 0;
-#endif
 
     for (int i = 0; i < lim; i++) {
         int x = rand() % 5;
@@ -239,23 +164,11 @@ int main() {
                 incorrect = true;
         }
 
-        printf("\033[2J");
-        printf("%d\n", i);
-
         if (incorrect == true) {
             cout << i << " " << x << endl;
-            return 0;
+            return 1;
         }
     }
 
-    int threads = 5;
-
-    vector<pthread_t> tid(threads);
-    for (int i = 0; i < threads; i++) {
-        tid[i] = i;
-        pthread_create(&tid[i], NULL, myThreadFun, (void *)&tid[i]);
-    }
-    for (int i = 0; i < threads; i++)
-        pthread_join(tid[i], NULL);
     return 0;
 }
@@ -0,0 +1,86 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// cold load of ENTRIES random keys into an empty store: one put per key,
+// multiPut batches, bulkLoad on shuffled and on already sorted input, and
+// bulkLoad of shuffled input split over 2 to MAX_THREADS threads
+#define ENTRIES 10000000
+#define MAX_THREADS 16
+#define BATCH_SIZE 4096
+
+// prints the seconds load takes on a fresh store, false if keys went missing
+template<typename F>
+bool run(const char *method, F load, int expected) {
+    struct timespec st, en;
+    kvStore kv(ENTRIES);
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    load(kv);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+
+    char buffer[256];
+    kvStore::Cursor cursor(kv, buffer);
+    int n = 0;
+    for (bool ok = cursor.seek(0); ok; ok = cursor.next())
+        n++;
+    printf("%s,%.3lf,%d\n", method, timer(en) - timer(st), n);
+    return n == expected;
+}
+
+int main() {
+    mt19937 rng(0);
+    vector<char> bytes(ENTRIES * (size_t) (MAX_KEY_LEN + 1));
+    vector<Slice> keys(ENTRIES), values(ENTRIES);
+    Slice value = benchValue();
+
+    char *at = bytes.data();
+    for (int i = 0; i < ENTRIES; i++) {
+        int size = rng() % MAX_KEY_LEN + 1;
+        for (int c = 0; c < size; c++)
+            at[c] = alpha[rng() % 52];
+        keys[i] = Slice(at, size);
+        values[i] = value;
+        at += size;
+    }
+
+    vector<int> order;
+    sortBatch(keys.data(), ENTRIES, order);
+    vector<Slice> sortedKeys(ENTRIES);
+    for (int i = 0; i < ENTRIES; i++)
+        sortedKeys[i] = keys[order[i]];
+    set<string> distinct;
+    for (auto &k : sortedKeys)
+        distinct.insert(string(k.data, k.size));
+    int expected = distinct.size();
+    distinct.clear();
+
+    printf("method,seconds,entries\n");
+    bool ok = true;
+    ok &= run("put", [&](kvStore &kv) {
+        for (int i = 0; i < ENTRIES; i++)
+            kv.put(keys[i], values[i]);
+    }, expected);
+    ok &= run("multiPut", [&](kvStore &kv) {
+        unique_ptr<bool[]> overwritten(new bool[BATCH_SIZE]);
+        for (int i = 0; i < ENTRIES; i += BATCH_SIZE)
+            kv.multiPut(&keys[i], &values[i], overwritten.get(), min(BATCH_SIZE, ENTRIES - i));
+    }, expected);
+    ok &= run("bulkLoad", [&](kvStore &kv) {
+        kv.bulkLoad(keys.data(), values.data(), ENTRIES);
+    }, expected);
+    ok &= run("bulkLoad_sorted", [&](kvStore &kv) {
+        kv.bulkLoad(sortedKeys.data(), values.data(), ENTRIES, true);
+    }, expected);
+    for (int threads = 2; threads <= MAX_THREADS; threads *= 2) {
+        char method[32];
+        snprintf(method, sizeof(method), "bulkLoad_%d_threads", threads);
+        ok &= run(method, [&](kvStore &kv) {
+            kv.bulkLoad(keys.data(), values.data(), ENTRIES, false, threads);
+        }, expected);
+    }
+
+    return !ok;
+}
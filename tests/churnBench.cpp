@@ -0,0 +1,73 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "ctrie.hpp"
+
+using namespace std;
+
+// keeps LIVE_KEYS keys in a trie while every round deletes and re-inserts
+// CHURN_PER_ROUND of them, and reports whether node count, lookup depth and
+// memory stay flat as the key set turns over
+#define LIVE_KEYS 500000
+#define ROUNDS 20
+#define CHURN_PER_ROUND 250000
+#define MAX_KEY_LEN 32
+#include "workload.hpp"
+
+long rssKB() {
+    long kb = 0;
+    char line[256];
+    FILE *f = fopen("/proc/self/status", "r");
+    while (f && fgets(line, sizeof(line), f))
+        if (!strncmp(line, "VmRSS:", 6))
+            kb = atol(line + 6);
+    if (f) fclose(f);
+    return kb;
+}
+
+// number of nodes and the summed node depth of every key
+void walk(CompressedTrieNode *node, long depth, long &nodes, long &depths) {
+    nodes++;
+    if (node->isLeaf)
+        depths += depth;
+    node->sucs.forEach([&](CompressedTrieNode *kid) {
+        walk(kid, depth + 1, nodes, depths);
+        return false;
+    });
+}
+
+int main() {
+    unsigned seed = 0;
+    CompressedTrie T(LIVE_KEYS);
+    vector<string> keys;
+    Slice value = benchValue();
+
+    while (keys.size() < LIVE_KEYS) {
+        string k = randomKey(seed, MAX_KEY_LEN);
+        if (!T.insert(Slice(&k[0], k.size()), value))
+            keys.push_back(k);
+    }
+
+    printf("round,keys,nodes,avg_depth,log_mb,rss_mb,round_s\n");
+    for (int round = 0; round <= ROUNDS; round++) {
+        struct timespec st, en;
+        clock_gettime(CLOCK_MONOTONIC, &st);
+        for (int i = 0; round && i < CHURN_PER_ROUND; i++) {
+            string &victim = keys[rand_r(&seed) % keys.size()];
+            T.del(Slice(&victim[0], victim.size()));
+            do {
+                victim = randomKey(seed, MAX_KEY_LEN);
+            } while (T.insert(Slice(&victim[0], victim.size()), value));
+        }
+        while (T.garbageRatio() > COMPACT_THRESHOLD && T.compact());
+        T.reclaim();
+        clock_gettime(CLOCK_MONOTONIC, &en);
+
+        long nodes = 0, depths = 0;
+        walk(T.root, 0, nodes, depths);
+        printf("%d,%d,%ld,%.2lf,%.1lf,%.1lf,%.3lf\n", round, T.size(), nodes,
+               (double) depths / T.size(), T.arena->log.reservedBytes() / 1048576.0,
+               rssKB() / 1024.0, timer(en) - timer(st));
+    }
+
+    return 0;
+}
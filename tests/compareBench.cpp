@@ -0,0 +1,356 @@
+#include <bits/stdc++.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ctrie.hpp"
+#include "histogram.hpp"
+#include "workload.hpp"
+// last, its min(int, int) would make std::min calls above ambiguous
+#include "trie.hpp"
+
+using namespace std;
+
+// The same workload on CompressedTrie, the dense 52-way TrieNode,
+// std::map, std::unordered_map and a sorted vector of pairs: loading KEYS
+// keys, random gets and updates, rank queries (N-th key), one full scan in
+// key order, and erases. Prints a CSV row per structure and phase with
+// throughput, latency percentiles (ns) and the peak RSS so far above what
+// the shared key set takes. Each structure runs in a child process of its
+// own, so peaks don't carry over.
+//
+//   compareBench [-n keys] [structure ...]
+//
+// TrieNode spends some 450 bytes on every key character, hence the modest
+// default. Phases a structure can't serve (rank and scan on the hash map)
+// are left out; the scan row times a single pass. The sorted vector is
+// filled by sorting once and erases from it shift the tail, std::map ranks
+// by walking from the first key, so ERASES and RANKS stay small.
+#define KEYS 200000
+#define LOOKUPS 1000000
+#define UPDATES 200000
+#define RANKS 1000
+#define ERASES 10000
+#define VALUE_LEN 16
+
+static char value[VALUE_LEN + 1] = "vvvvvvvvvvvvvvvv";
+
+struct CompressedTrieEngine {
+    static const bool ordered = true;
+    CompressedTrie T;
+    char buffer[256];
+
+    void put(const string &k) {
+        T.insert(Slice((char *) k.data(), k.size()), Slice(value, VALUE_LEN));
+    }
+
+    void loaded() {}
+
+    bool get(const string &k) {
+        Slice v;
+        return T.search(Slice((char *) k.data(), k.size()), v);
+    }
+
+    bool rank(uint64_t n) {
+        Slice key, v;
+        if (!T.search((int) n + 1, key, v))
+            return false;
+        free(key.data);
+        return true;
+    }
+
+    uint64_t scan() {
+        uint64_t seen = 0;
+        TrieCursor cursor(&T, buffer);
+        for (bool ok = cursor.seek(Slice(buffer, 0)); ok; ok = cursor.next())
+            seen++;
+        return seen;
+    }
+
+    bool erase(const string &k) {
+        return T.del(Slice((char *) k.data(), k.size()));
+    }
+};
+
+struct TrieNodeEngine {
+    static const bool ordered = true;
+    TrieNode root;
+
+    // TrieNode keeps the value it is given and frees it on erase
+    void put(const string &k) {
+        int size;
+        char *old = root.lookup((char *) k.data(), k.size(), size);
+        root.insert((char *) k.data(), k.size(), strdup(value), VALUE_LEN);
+        free(old);
+    }
+
+    void loaded() {}
+
+    bool get(const string &k) {
+        int size;
+        return root.lookup((char *) k.data(), k.size(), size);
+    }
+
+    bool rank(uint64_t n) {
+        char *key = nullptr, *v;
+        int ksize = 0, vsize = 0;
+        if (!root.lookupN(n + 1, &key, &v, ksize, vsize))
+            return false;
+        free(key);
+        return true;
+    }
+
+    // children are in byte order, so a depth-first walk is key order
+    static uint64_t walk(TrieNode *node) {
+        uint64_t seen = node->value != nullptr;
+        for (int i = 0; i < RANGE; i++)
+            if (node->p[i])
+                seen += walk(node->p[i]);
+        return seen;
+    }
+
+    uint64_t scan() {
+        return walk(&root);
+    }
+
+    bool erase(const string &k) {
+        return root.erase((char *) k.data(), k.size());
+    }
+};
+
+struct MapEngine {
+    static const bool ordered = true;
+    map<string, string> m;
+
+    void put(const string &k) {
+        m[k].assign(value, VALUE_LEN);
+    }
+
+    void loaded() {}
+
+    bool get(const string &k) {
+        return m.find(k) != m.end();
+    }
+
+    // linear: std::map keeps no subtree sizes
+    bool rank(uint64_t n) {
+        if (n >= m.size())
+            return false;
+        return !next(m.begin(), n)->first.empty();
+    }
+
+    uint64_t scan() {
+        uint64_t seen = 0;
+        for (auto &entry : m)
+            seen += !entry.first.empty();
+        return seen;
+    }
+
+    bool erase(const string &k) {
+        return m.erase(k);
+    }
+};
+
+struct HashEngine {
+    static const bool ordered = false;
+    unordered_map<string, string> m;
+
+    void put(const string &k) {
+        m[k].assign(value, VALUE_LEN);
+    }
+
+    void loaded() {}
+
+    bool get(const string &k) {
+        return m.find(k) != m.end();
+    }
+
+    // no key order to rank or scan in
+    bool rank(uint64_t) {
+        return false;
+    }
+
+    uint64_t scan() {
+        return 0;
+    }
+
+    bool erase(const string &k) {
+        return m.erase(k);
+    }
+};
+
+struct SortedVectorEngine {
+    static const bool ordered = true;
+    vector<pair<string, string>> v;
+    bool sorted = false;
+
+    static bool before(const pair<string, string> &entry, const string &k) {
+        return entry.first < k;
+    }
+
+    // appends while loading, overwrites in place once sorted
+    void put(const string &k) {
+        if (!sorted) {
+            v.emplace_back(k, string(value, VALUE_LEN));
+            return;
+        }
+        auto it = lower_bound(v.begin(), v.end(), k, before);
+        if (it != v.end() && it->first == k)
+            it->second.assign(value, VALUE_LEN);
+        else
+            v.emplace(it, k, string(value, VALUE_LEN));
+    }
+
+    void loaded() {
+        sort(v.begin(), v.end());
+        sorted = true;
+    }
+
+    bool get(const string &k) {
+        auto it = lower_bound(v.begin(), v.end(), k, before);
+        return it != v.end() && it->first == k;
+    }
+
+    bool rank(uint64_t n) {
+        return n < v.size() && !v[n].first.empty();
+    }
+
+    uint64_t scan() {
+        uint64_t seen = 0;
+        for (auto &entry : v)
+            seen += !entry.first.empty();
+        return seen;
+    }
+
+    bool erase(const string &k) {
+        auto it = lower_bound(v.begin(), v.end(), k, before);
+        if (it == v.end() || it->first != k)
+            return false;
+        v.erase(it);
+        return true;
+    }
+};
+
+long statusKB(const char *field) {
+    long kb = 0;
+    char line[256];
+    FILE *f = fopen("/proc/self/status", "r");
+    while (f && fgets(line, sizeof(line), f))
+        if (!strncmp(line, field, strlen(field)))
+            kb = atol(line + strlen(field));
+    if (f) fclose(f);
+    return kb;
+}
+
+class Report {
+    const char *name;
+    long baseKB;
+
+public:
+    Report(const char *name) : name(name), baseKB(statusKB("VmRSS:")) {}
+
+    void row(const char *phase, const LatencyHistogram &h, double seconds) {
+        printf("%s,%s,%lu,%.0lf,%lu,%lu,%lu,%lu,%.1lf\n", name, phase, h.count(), h.count() / seconds,
+               h.percentile(0.5), h.percentile(0.99), h.percentile(0.999), h.max(),
+               (statusKB("VmHWM:") - baseKB) / 1024.0);
+        fflush(stdout);
+    }
+};
+
+// times f(i) for i in [0, n) into a row
+template<typename F>
+void phase(Report &report, const char *name, uint64_t n, F f) {
+    LatencyHistogram h;
+    uint64_t start = nowNs();
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t at = nowNs();
+        f(i);
+        h.record(nowNs() - at);
+    }
+    report.row(name, h, (nowNs() - start) / 1e9);
+}
+
+template<typename E>
+int run(const char *name, const vector<string> &keys) {
+    Report report(name);
+    unique_ptr<E> e(new E());
+    Rng rng(1);
+    uint64_t n = keys.size(), hits = 0;
+
+    {
+        LatencyHistogram h;
+        uint64_t start = nowNs();
+        for (auto &k : keys) {
+            uint64_t at = nowNs();
+            e->put(k);
+            h.record(nowNs() - at);
+        }
+        // the sorted vector's sort counts toward loading, not toward any key
+        e->loaded();
+        report.row("load", h, (nowNs() - start) / 1e9);
+    }
+    phase(report, "get", LOOKUPS, [&](uint64_t) { hits += e->get(keys[rng.below(n)]); });
+    phase(report, "update", UPDATES, [&](uint64_t) { e->put(keys[rng.below(n)]); });
+    if (E::ordered) {
+        phase(report, "rank", RANKS, [&](uint64_t) { hits += e->rank(rng.below(n)); });
+        uint64_t seen = 0;
+        phase(report, "scan", 1, [&](uint64_t) { seen = e->scan(); });
+        if (seen != n)
+            return 1;
+    }
+    // distinct keys, so every erase hits
+    phase(report, "erase", ERASES, [&](uint64_t i) { hits += e->erase(keys[i * (n / ERASES)]); });
+
+    // every lookup found its key
+    uint64_t expected = LOOKUPS + ERASES + (E::ordered ? RANKS : 0);
+    return hits != expected;
+}
+
+int main(int argc, char **argv) {
+    uint64_t n = KEYS;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt != 'n') {
+            fprintf(stderr, "usage: %s [-n keys] [compressed_trie|trie_node|map|unordered_map|sorted_vector ...]\n",
+                    argv[0]);
+            return 1;
+        }
+        n = strtoull(optarg, nullptr, 10);
+    }
+    if (n < ERASES)
+        n = ERASES;
+
+    vector<string> keys(n, string(WORKLOAD_KEY_LEN, ' '));
+    for (uint64_t i = 0; i < n; i++)
+        keyOf(i, &keys[i][0]);
+
+    struct Structure {
+        const char *name;
+        int (*run)(const char *, const vector<string> &);
+    } structures[] = {
+        {"compressed_trie", run<CompressedTrieEngine>},
+        {"trie_node", run<TrieNodeEngine>},
+        {"map", run<MapEngine>},
+        {"unordered_map", run<HashEngine>},
+        {"sorted_vector", run<SortedVectorEngine>},
+    };
+
+    printf("structure,phase,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns,peak_rss_mb\n");
+    fflush(stdout);
+    int failed = 0;
+    for (auto &s : structures) {
+        bool wanted = optind >= argc;
+        for (int a = optind; a < argc; a++)
+            wanted |= !strcmp(argv[a], s.name);
+        if (!wanted)
+            continue;
+        pid_t child = fork();
+        if (child == 0)
+            _exit(s.run(s.name, keys));
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            fprintf(stderr, "%s failed\n", s.name);
+            failed = 1;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,100 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "frozenTrie.hpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// memory and read cost of a trie over SEED random keys against the same
+// keys frozen: bytes held, random gets, rank queries (get(N)) and prefix
+// scans over two-character prefixes
+#define LOOKUPS 1000000
+#define RANK_LOOKUPS 100000
+#define SCANS 1000
+
+size_t trieBytes(CompressedTrie &T) {
+    ArtPools &art = T.arena->art;
+    return T.arena->nodes.reservedBytes() + art.node4.reservedBytes() + art.node16.reservedBytes() +
+           art.node48.reservedBytes() + art.node256.reservedBytes() + T.arena->log.reservedBytes();
+}
+
+// nanoseconds per call of f(i) for i in [0, n)
+template<typename F>
+double perCall(int n, F f) {
+    struct timespec st, en;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int i = 0; i < n; i++)
+        f(i);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    return (timer(en) - timer(st)) * 1e9 / n;
+}
+
+int main() {
+    unsigned seed = 0;
+    vector<string> keys = randomKeys(seed, SEED);
+    Slice v = benchValue();
+
+    // unreserved, so the trie holds only the slabs it filled
+    CompressedTrie T;
+    size_t rawBytes = 0;
+    for (auto &k : keys)
+        T.insert(Slice(&k[0], k.size()), v);
+    int entries = T.size();
+    for (auto &k : keys)
+        rawBytes += k.size();
+    rawBytes = rawBytes / keys.size() * entries + (size_t) entries * VALUE_LEN;
+
+    struct timespec st, en;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    FrozenTrie F(T);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("freeze_seconds,%.3lf\n", timer(en) - timer(st));
+    printf("metric,trie,frozen\n");
+    printf("bytes,%zu,%zu\n", trieBytes(T), F.bytes());
+    printf("bytes_per_key,%.1lf,%.1lf\n", (double) trieBytes(T) / entries, (double) F.bytes() / entries);
+    printf("raw_bytes_per_key,%.1lf,%.1lf\n", (double) rawBytes / entries, (double) rawBytes / entries);
+
+    vector<int> picks(LOOKUPS);
+    for (auto &p : picks)
+        p = rand_r(&seed) % keys.size();
+    long hits = 0;
+    Slice key, val;
+    double trieGet = perCall(LOOKUPS, [&](int i) {
+        Slice k(&keys[picks[i]][0], keys[picks[i]].size());
+        hits += T.search(k, val);
+    });
+    double frozenGet = perCall(LOOKUPS, [&](int i) {
+        Slice k(&keys[picks[i]][0], keys[picks[i]].size());
+        hits -= F.search(k, val);
+    });
+    printf("get_ns,%.0lf,%.0lf\n", trieGet, frozenGet);
+
+    double trieRank = perCall(RANK_LOOKUPS, [&](int i) {
+        hits += T.search(picks[i] % entries + 1, key, val);
+        free(key.data);
+    });
+    double frozenRank = perCall(RANK_LOOKUPS, [&](int i) {
+        hits -= F.search(picks[i] % entries + 1, key, val);
+        free(key.data);
+    });
+    printf("get_n_ns,%.0lf,%.0lf\n", trieRank, frozenRank);
+
+    long trieSeen = 0, frozenSeen = 0;
+    char buffer[256];
+    double trieScan = perCall(SCANS, [&](int i) {
+        char p[2] = {alpha[i % 52], alpha[i / 52 % 52]};
+        TrieCursor cursor(&T, buffer);
+        for (bool ok = cursor.prefixScan(Slice(p, 2)); ok; ok = cursor.next())
+            trieSeen += cursor.value().size;
+    });
+    double frozenScan = perCall(SCANS, [&](int i) {
+        char p[2] = {alpha[i % 52], alpha[i / 52 % 52]};
+        F.prefixScan(Slice(p, 2), [&](const Slice &k, const Slice &value) {
+            frozenSeen += value.size;
+        });
+    });
+    printf("prefix_scan_us,%.1lf,%.1lf\n", trieScan / 1000, frozenScan / 1000);
+
+    // every lookup found the same in both
+    return hits != 0 || trieSeen != frozenSeen;
+}
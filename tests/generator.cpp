@@ -1,146 +1,196 @@
 #define SEED 10000  // no elements to be inserted at beginning
 #define MAX_KEY_LEN 64
 #define MAX_VALUE_LEN 240
-
-#define OP_TYPES 5
-#define LOOKUP_OP 0
-#define INSERT_OP 1
-#define ERASE_OP 2
-#define LOOKUPN_OP 3
-#define ERASEN_OP 4
 #define OP_COUNT (int)1e4
 //#define MAX_OUT
-#define PREFIX_OVERLAP
+// percentage of new keys that start with part of an existing key
+#define PREFIX_OVERLAP 100
 
 #include <vector>
-#include <iostream>
 #include <string>
 #include <cstdlib>
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
-#include <cassert>
-#include <set>
+#include <unistd.h>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include "trace.hpp"
+#include "workload.hpp"
 
 using namespace std;
-
-set<string> inserted;
-#define contSize(x) (int)x.size()
-
-static const char alpha[] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-    "abcdefghijklmnopqrstuvwxyz";
-
-static int alpha_len = strlen(alpha);
-
-string getNth(int n) {
-    auto iterator = inserted.begin();
-
-    for (int i = 1; i < n; i++) {
-        iterator++;
-    }
-
-    return *iterator;
-}
+using namespace __gnu_pbds;
+
+// Writes a binary trace (see trace.hpp) of SEED inserts followed by ops
+// random operations over the keys inserted so far:
+//
+//   generator [-o path] [-n ops] [-s seed] [-m lookup,insert,erase,lookupN,eraseN]
+//             [-z theta] [-p overlap] [-r random seed]
+//
+// -m weighs the operation types (equal by default), -z picks existing keys
+// by a zipfian of that skew (0 < theta < 1, YCSB uses 0.99) instead of
+// uniformly, -p sets PREFIX_OVERLAP.
+//
+// The live keys are kept in an order-statistic tree, so every operation,
+// the N-th key included, costs O(log n) and 100M-operation traces take
+// minutes.
+
+typedef tree<string, null_type, less<string>, rb_tree_tag, tree_order_statistics_node_update> OrderedSet;
+
+OrderedSet inserted;
+Rng rng(42);
+Zipfian *zipf = nullptr;
+int overlap = PREFIX_OVERLAP;
 
 string alpha_rand(const int len) {
-    string s;
-    for (int i = 0; i < len; ++i) {
-        s += alpha[rand() % (alpha_len)];
+    string s(len, ' ');
+    uint64_t bits = 0;
+    for (int i = 0; i < len; i++) {
+        if (i % 10 == 0)
+            bits = rng.next();
+        s[i] = alpha[bits % 52];
+        bits /= 52;
     }
-
     return s;
 }
 
+// zero-indexed rank of an existing key
+uint64_t pickRank() {
+    if (zipf)
+        return mix64(zipf->next(rng)) % inserted.size();
+    return rng.below(inserted.size());
+}
+
 string rand_string_wrapper(bool isValue = false) {
     int modder = isValue ? MAX_VALUE_LEN : MAX_KEY_LEN;
-    int sizeString = rand() % modder + 1;
+    int sizeString = rng.below(modder) + 1;
 #ifdef MAX_OUT
     sizeString = modder;
 #endif
 
     string result = alpha_rand(sizeString);
 
-#ifdef PREFIX_OVERLAP
-    if (inserted.empty())
+    if (isValue || inserted.empty() || (int) rng.below(100) >= overlap)
         return result;
-    int randNth = rand() % contSize(inserted) + 1;
-    string nth = getNth(randNth);
-    int overlap = rand() % contSize(nth);
-    string prefix = nth.substr(0, overlap);
-    result = prefix.substr(0, sizeString) +
-             result.substr(0, max(0, sizeString - overlap));
-#endif
-
-    return result;
+    const string &nth = *inserted.find_by_order(pickRank());
+    int shared = rng.below(nth.size());
+    return nth.substr(0, min(shared, sizeString)) + result.substr(0, max(0, sizeString - shared));
 }
 
-void printNewKeyValue() {
+void writeNewKeyValue(TraceWriter &out) {
     string newKey;
 
     while (1) {
         newKey = rand_string_wrapper();
-        if (inserted.find(newKey) == inserted.end()) {
-            inserted.insert(newKey);
+        if (inserted.insert(newKey).second)
             break;
-        }
     }
 
-    printf("%s %s\n", newKey.c_str(), rand_string_wrapper(true).c_str());
+    string value = rand_string_wrapper(true);
+    out.keyed(INSERT_OP, newKey.data(), newKey.size(), value.data(), value.size());
 }
 
-int main() {
-    srand(42);  // time(0));
+int main(int argc, char **argv) {
+    const char *path = "../tests/genInp.trace";
+    uint64_t seed = SEED, ops = OP_COUNT;
+    double weights[TRACE_OP_TYPES] = {1, 1, 1, 1, 1}, theta = 0;
 
-    int totalOps = SEED + OP_COUNT;
-    printf("%d\n", totalOps);
+    int opt;
+    while ((opt = getopt(argc, argv, "o:n:s:m:z:p:r:")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                ops = strtoull(optarg, nullptr, 10);
+                break;
+            case 's':
+                seed = strtoull(optarg, nullptr, 10);
+                break;
+            case 'm':
+                sscanf(optarg, "%lf,%lf,%lf,%lf,%lf", &weights[0], &weights[1], &weights[2], &weights[3],
+                       &weights[4]);
+                break;
+            case 'z':
+                theta = atof(optarg);
+                break;
+            case 'p':
+                overlap = atoi(optarg);
+                break;
+            case 'r':
+                rng = Rng(strtoull(optarg, nullptr, 10));
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o path] [-n ops] [-s seed] [-m l,i,e,ln,en] [-z theta] "
+                                "[-p overlap] [-r random seed]\n", argv[0]);
+                return 1;
+        }
+    }
 
-    for (int i = 0; i < SEED; i++) {
-        printf("%d ", INSERT_OP);
-        printNewKeyValue();
+    double total = 0;
+    for (double w : weights)
+        total += w;
+    if (total <= 0)
+        return 1;
+    // skewed toward whichever keys hash to the first ranks; sized for the
+    // seed keys, ranks past the current size wrap around
+    if (theta > 0 && theta < 1)
+        zipf = new Zipfian(max<uint64_t>(seed, 2), theta);
+
+    TraceWriter out;
+    if (!out.open(path)) {
+        perror(path);
+        return 1;
     }
 
-    int rand_idx, op, nth;
-    string newstring, str;
+    for (uint64_t i = 0; i < seed; i++)
+        writeNewKeyValue(out);
 
-    for (int i = 1; i <= OP_COUNT; i++) {
-        op = rand() % OP_TYPES;
+    for (uint64_t i = 0; i < ops; i++) {
+        int op = TRACE_OP_TYPES - 1;
+        double u = rng.uniform() * total;
+        for (int t = 0; t < TRACE_OP_TYPES - 1; t++) {
+            if (u < weights[t]) {
+                op = t;
+                break;
+            }
+            u -= weights[t];
+        }
 
         if (inserted.empty())
             op = INSERT_OP;
-        else {
-            rand_idx = rand() % contSize(inserted);
-            nth = rand_idx + 1;
-        }
-
 #ifdef MAX_OUT
         op = INSERT_OP;
 #endif
 
-        printf("%d ", op);
+        uint64_t rank = op == INSERT_OP ? 0 : pickRank();
+        string str;
         switch (op) {
             case INSERT_OP:
-                printNewKeyValue();
+                writeNewKeyValue(out);
                 break;
             case LOOKUP_OP:
-                printf("%s\n", getNth(nth).c_str());
+                str = *inserted.find_by_order(rank);
+                out.keyed(op, str.data(), str.size());
                 break;
             case ERASE_OP:
-                str = getNth(nth);
-                printf("%s\n", str.c_str());
+                str = *inserted.find_by_order(rank);
+                out.keyed(op, str.data(), str.size());
                 inserted.erase(str);
                 break;
             case LOOKUPN_OP:
-                printf("%d\n", nth);
+                out.ranked(op, rank + 1);
                 break;
             case ERASEN_OP:
-                str = getNth(nth);
-                printf("%d\n", nth);
-                inserted.erase(str);
-                break;
-            default:
-                assert(false);
+                out.ranked(op, rank + 1);
+                inserted.erase(inserted.find_by_order(rank));
                 break;
         }
     }
+
+    if (!out.close()) {
+        perror(path);
+        return 1;
+    }
+    return 0;
 }
@@ -0,0 +1,74 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "ctrie.hpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// label memory and insert/lookup cost of a trie, built once as is
+// (labelBench) and once with -DPACKED_LABELS (labelBenchPacked): on random
+// keys, and on keys sharing long prefixes, where comparing labels is most
+// of the work
+#define LOOKUPS 1000000
+#define PREFIXES 64
+
+// label characters and the log bytes their records take
+void labelBytes(CompressedTrie &T, CompressedTrieNode *node, long &chars, long &bytes) {
+    node->sucs.forEach([&](CompressedTrieNode *kid) {
+        chars += kid->edgeLabelSize;
+        bytes += recordBytes(T.arena->log.header(kid->edgelabel)->size);
+        labelBytes(T, kid, chars, bytes);
+        return false;
+    });
+}
+
+void run(const char *name, vector<string> &keys, unsigned &seed) {
+    Slice v = benchValue();
+    CompressedTrie T(SEED);
+    struct timespec st, en;
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (auto &k : keys)
+        T.insert(Slice(&k[0], k.size()), v);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    double insertNs = (timer(en) - timer(st)) * 1e9 / keys.size();
+
+    vector<int> picks(LOOKUPS);
+    for (auto &p : picks)
+        p = rand_r(&seed) % keys.size();
+    long hits = 0;
+    Slice val;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int p : picks)
+        hits += T.search(Slice(&keys[p][0], keys[p].size()), val);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    double searchNs = (timer(en) - timer(st)) * 1e9 / LOOKUPS;
+
+    long chars = 0, bytes = 0;
+    labelBytes(T, T.root, chars, bytes);
+    printf("%s,%.0lf,%.0lf,%ld,%ld,%ld\n", name, insertNs, searchNs, chars, bytes, LOOKUPS - hits);
+}
+
+int main() {
+    unsigned seed = 0;
+    vector<string> random = randomKeys(seed, SEED), prefixed, prefixes;
+
+    for (int i = 0; i < PREFIXES; i++) {
+        string p(48, ' ');
+        randomLetters(seed, &p[0], p.size());
+        prefixes.push_back(p);
+    }
+    for (int i = 0; i < SEED; i++) {
+        string k = prefixes[rand_r(&seed) % PREFIXES] + string(16, ' ');
+        randomLetters(seed, &k[48], 16);
+        prefixed.push_back(k);
+    }
+
+#ifdef PACKED_LABELS
+    printf("packed labels\n");
+#endif
+    printf("keys,insert_ns,search_ns,label_chars,label_log_bytes,missed\n");
+    run("random", random, seed);
+    run("shared_prefixes", prefixed, seed);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// Throughput of a get/put/del/get(N)/del(N) mix on THREADS threads, built
+// once as is (latencyBench) and once with -DFASTMAP_INSTRUMENT
+// (latencyBenchInstrumented), which also prints the store's latency
+// percentiles (the initial load included), lock waits and holds, and
+// structural counters. The two throughputs are the cost of instrumenting.
+#define THREADS 4
+#define OPS_PER_THREAD 250000
+
+#ifdef FASTMAP_INSTRUMENT
+void print(const char *name, const LatencyHistogram &h) {
+    printf("%s,%lu,%lu,%lu,%lu,%lu\n", name, h.count(), h.percentile(0.5), h.percentile(0.99),
+           h.percentile(0.999), h.max());
+}
+#endif
+
+int main() {
+    kvStore kv(SEED);
+    unsigned seed = 0;
+    preload(kv, randomKeys(seed, SEED));
+
+    struct timespec st, en;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    vector<thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&kv, t] {
+            unsigned seed = t + 1;
+            Slice v = benchValue(), key, val;
+            for (int i = 0; i < OPS_PER_THREAD; i++) {
+                string k = randomKey(seed, MAX_KEY_LEN);
+                Slice s(&k[0], k.size());
+                int op = rand_r(&seed) % 10;
+                // mostly gets, puts and dels balance out
+                if (op < 6) {
+                    kv.get(s, val);
+                } else if (op < 8) {
+                    kv.put(s, v);
+                } else if (op == 8) {
+                    kv.del(s);
+                } else if (rand_r(&seed) % 2) {
+                    if (kv.get(rand_r(&seed) % SEED / 2, key, val))
+                        free(key.data);
+                } else {
+                    kv.del(rand_r(&seed) % SEED / 2);
+                    kv.put(s, v);
+                }
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("threads,ops_per_sec\n%d,%.0lf\n", THREADS, THREADS * OPS_PER_THREAD / (timer(en) - timer(st)));
+
+#ifdef FASTMAP_INSTRUMENT
+    Instrumentation in = kv.instrumentation();
+    const char *names[OP_KINDS] = {"get", "put", "del", "get_n", "del_n"};
+    printf("latency,count,p50_ns,p99_ns,p999_ns,max_ns\n");
+    for (int op = 0; op < OP_KINDS; op++)
+        print(names[op], in.latencies.ops[op]);
+    print("read_lock_wait", in.latencies.readWait);
+    print("write_lock_wait", in.latencies.writeWait);
+    print("write_lock_hold", in.latencies.writeHold);
+    printf("splits,merges,settle_steps\n%lu,%lu,%lu\n", in.trie.splits, in.trie.merges, in.trie.settleSteps);
+#endif
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "label.hpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// nanoseconds per common-prefix computation of a label and a key, byte by
+// byte and with each matchLength kernel, for several length distributions.
+// Pairs share a random prefix of their length, so loops stop anywhere.
+#define PAIRS 4096
+#define ROUNDS 2000
+
+struct Pair {
+    string label, key;
+};
+
+static int matchBytes(const char *a, const char *b, int m, int n) {
+    while (m < n && a[m] == b[m])
+        m++;
+    return m;
+}
+
+template<typename F>
+double perCall(const vector<Pair> &pairs, F f, long &check) {
+    struct timespec st, en;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int r = 0; r < ROUNDS; r++)
+        for (auto &p : pairs)
+            check += f(p.label.data(), p.key.data(), 0, (int) p.label.size());
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    return (timer(en) - timer(st)) * 1e9 / ((double) ROUNDS * pairs.size());
+}
+
+int main() {
+    unsigned seed = 0;
+    struct Distribution {
+        const char *name;
+        int lo, hi;
+    } distributions[] = {{"short_1_8", 1, 8}, {"uniform_1_64", 1, 64}, {"long_32_64", 32, 64}, {"full_64", 64, 64}};
+
+    printf("lengths,bytes_ns,words_ns,");
+#ifdef __SSE2__
+    printf("sse2_ns,%s", hasAvx2 ? "avx2_ns," : "");
+#endif
+    printf("matchLength_ns\n");
+
+    for (auto &d : distributions) {
+        vector<Pair> pairs(PAIRS);
+        for (auto &p : pairs) {
+            int n = d.lo + rand_r(&seed) % (d.hi - d.lo + 1);
+            p.label.resize(n);
+            randomLetters(seed, &p.label[0], n);
+            p.key = p.label;
+            // half the pairs match all the way
+            int at = rand_r(&seed) % (2 * n);
+            if (at < n)
+                p.key[at] = p.key[at] == 'a' ? 'b' : 'a';
+        }
+
+        long expected = 0, check = 0;
+        printf("%s,%.2lf,", d.name, perCall(pairs, matchBytes, expected));
+        printf("%.2lf,", perCall(pairs, matchWords, check));
+#ifdef __SSE2__
+        printf("%.2lf,", perCall(pairs, matchSse2, check));
+        if (hasAvx2)
+            printf("%.2lf,", perCall(pairs, matchAvx2, check));
+#endif
+        printf("%.2lf\n", perCall(pairs, [](const char *a, const char *b, int m, int n) {
+            return matchLength(a, b, n);
+        }, check));
+        // every kernel found the same prefixes
+        int kernels = 2;
+#ifdef __SSE2__
+        kernels += 1 + hasAvx2;
+#endif
+        if (check != kernels * expected)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// compares get() latency with and without the 4-character prefix cache.
+// "cold" samples evict the CPU caches before every timed lookup, "warm"
+// runs lookups back to back.
+#define COLD_SAMPLES 2000
+#define WARM_LOOKUPS 1000000
+#define EVICT_BYTES (64 << 20)
+#define MAX_VALUE_LEN 64
+
+vector<Slice> keys;
+vector<char> evictBuffer(EVICT_BYTES);
+
+void evict() {
+    static char sink = 0;
+    for (size_t i = 0; i < evictBuffer.size(); i += 64) {
+        evictBuffer[i]++;
+        sink += evictBuffer[i];
+    }
+}
+
+void measure(kvStore &kv, const char *label) {
+    unsigned seed = 7;
+    struct timespec st, en;
+    vector<double> cold;
+
+    for (int i = 0; i < COLD_SAMPLES; i++) {
+        Slice &key = keys[rand_r(&seed) % keys.size()];
+        Slice value;
+        evict();
+        clock_gettime(CLOCK_MONOTONIC, &st);
+        kv.get(key, value);
+        clock_gettime(CLOCK_MONOTONIC, &en);
+        cold.push_back((timer(en) - timer(st)) * 1e9);
+    }
+    sort(cold.begin(), cold.end());
+    double coldMean = accumulate(cold.begin(), cold.end(), 0.0) / cold.size();
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int i = 0; i < WARM_LOOKUPS; i++) {
+        Slice value;
+        kv.get(keys[rand_r(&seed) % keys.size()], value);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    double warm = (timer(en) - timer(st)) * 1e9 / WARM_LOOKUPS;
+
+    printf("%s,%.0lf,%.0lf,%.0lf,%.0lf\n", label, coldMean,
+           cold[cold.size() / 2], cold[cold.size() * 99 / 100], warm);
+}
+
+int main() {
+    unsigned seed = 0;
+    kvStore kv(SEED);
+
+    for (int i = 0; i < SEED; i++) {
+        keys.push_back(overlappingKey(seed, keys));
+        Slice value;
+        value.size = rand_r(&seed) % MAX_VALUE_LEN + 1;
+        value.data = (char *)malloc(value.size);
+        memset(value.data, 'v', value.size);
+        kv.put(keys.back(), value);
+        free(value.data);
+    }
+
+    printf("mode,cold_mean_ns,cold_p50_ns,cold_p99_ns,warm_ns\n");
+    measure(kv, "trie");
+    kv.enablePrefixCache();
+    measure(kv, "prefix_cache");
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// get latency percentiles from READERS threads while 0 to MAX_WRITERS
+// threads put and delete keys as fast as they can
+#define READERS 2
+#define MAX_WRITERS 4
+#define RUN_SECONDS 2
+// every SAMPLE_EVERY-th get is timed
+#define SAMPLE_EVERY 16
+
+inline long long nanos() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+int main() {
+    unsigned seed = 0;
+    kvStore kv(SEED);
+    // writers churn the second half, readers look up all keys
+    vector<string> keys = randomKeys(seed, SEED);
+    preload(kv, keys);
+
+    printf("writers,reads_s,writes_s,p50_ns,p99_ns,p999_ns\n");
+    for (int writers = 0; writers <= MAX_WRITERS; writers = writers ? writers * 2 : 1) {
+        atomic<bool> running(true);
+        atomic<long long> reads(0), writes(0);
+        vector<vector<long long>> samples(READERS);
+        vector<thread> threads;
+
+        for (int w = 0; w < writers; w++) {
+            threads.emplace_back([&, w] {
+                unsigned s = 1000 + w;
+                long long n = 0;
+                Slice v = benchValue();
+                while (running) {
+                    string &k = keys[SEED / 2 + rand_r(&s) % (SEED / 2)];
+                    Slice key(&k[0], k.size());
+                    if (rand_r(&s) % 2)
+                        kv.put(key, v);
+                    else
+                        kv.del(key);
+                    n++;
+                }
+                writes += n;
+            });
+        }
+        for (int r = 0; r < READERS; r++) {
+            threads.emplace_back([&, r] {
+                unsigned s = 2000 + r;
+                long long n = 0;
+                while (running) {
+                    string &k = keys[rand_r(&s) % SEED];
+                    Slice key(&k[0], k.size()), val;
+                    if (n % SAMPLE_EVERY) {
+                        kv.get(key, val);
+                    } else {
+                        long long st = nanos();
+                        kv.get(key, val);
+                        samples[r].push_back(nanos() - st);
+                    }
+                    n++;
+                }
+                reads += n;
+            });
+        }
+
+        this_thread::sleep_for(chrono::seconds(RUN_SECONDS));
+        running = false;
+        for (auto &t : threads)
+            t.join();
+
+        vector<long long> all;
+        for (auto &s : samples)
+            all.insert(all.end(), s.begin(), s.end());
+        sort(all.begin(), all.end());
+        auto pct = [&](double p) {
+            return all.empty() ? 0 : all[min(all.size() - 1, (size_t) (p * all.size()))];
+        };
+        printf("%d,%.0lf,%.0lf,%lld,%lld,%lld\n", writers, (double) reads / RUN_SECONDS,
+               (double) writes / RUN_SECONDS, pct(0.5), pct(0.99), pct(0.999));
+    }
+    return 0;
+}
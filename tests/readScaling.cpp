@@ -0,0 +1,142 @@
+#include <bits/stdc++.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "kvStore.cpp"
+#include "shardedKvStore.cpp"
+
+// preloaded keys, fewer than the other benchmarks load
+#define SEED 100000
+#include "workload.hpp"
+
+using namespace std;
+
+// read-heavy mix: READ_PERCENT of ops are get(key), the rest are puts
+//
+//   readScaling [-r read_percent] [-s shards] [max_threads]
+//
+// -s runs the mix on shardedKvStore instead of kvStore; with a low -r it
+// shows how far puts to different shards run in parallel.
+#define READ_PERCENT 90
+#define RUN_SECONDS 2
+#define MAX_VALUE_LEN 255
+
+vector<Slice> keys, values;
+volatile bool running;
+int readPercent = READ_PERCENT;
+
+template <typename Store>
+struct threadArgs {
+    Store *store;
+    unsigned seed;
+    long long ops;
+};
+
+Slice randomSlice(unsigned &seed, int maxLen) {
+    Slice s;
+    s.size = rand_r(&seed) % maxLen + 1;
+    s.data = (char *)malloc(s.size);
+    randomLetters(seed, s.data, s.size);
+    return s;
+}
+
+template <typename Store>
+void *worker(void *vargp) {
+    auto *args = (threadArgs<Store> *)vargp;
+    Store &kv = *args->store;
+    unsigned seed = args->seed;
+    long long ops = 0;
+
+    while (running) {
+        for (int i = 0; i < 1000; i++) {
+            Slice &key = keys[rand_r(&seed) % keys.size()];
+            if (rand_r(&seed) % 100 < readPercent) {
+                Slice value;
+                kv.get(key, value);
+            } else {
+                kv.put(key, values[rand_r(&seed) % values.size()]);
+            }
+        }
+        ops += 1000;
+    }
+
+    args->ops = ops;
+    return NULL;
+}
+
+template <typename Store>
+double run(Store &kv, int threads) {
+    vector<pthread_t> tid(threads);
+    vector<threadArgs<Store>> args(threads);
+    struct timespec st, en;
+
+    running = true;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int i = 0; i < threads; i++) {
+        args[i].store = &kv;
+        args[i].seed = 1000 + i;
+        pthread_create(&tid[i], NULL, worker<Store>, &args[i]);
+    }
+
+    struct timespec duration = {RUN_SECONDS, 0};
+    nanosleep(&duration, NULL);
+    running = false;
+
+    long long total = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tid[i], NULL);
+        total += args[i].ops;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+
+    return total / (timer(en) - timer(st));
+}
+
+template <typename Store>
+void scale(Store &kv, int maxThreads) {
+    for (int i = 0; i < SEED; i++)
+        kv.put(keys[i], values[i]);
+
+    printf("threads,ops_per_sec,speedup\n");
+    double base = 0;
+    for (int threads = 1; threads <= max(1, maxThreads); threads *= 2) {
+        double opsPerSec = run(kv, threads);
+        if (threads == 1)
+            base = opsPerSec;
+        printf("%d,%.0lf,%.2lf\n", threads, opsPerSec, opsPerSec / base);
+    }
+}
+
+int main(int argc, char **argv) {
+    int shards = 0, opt;
+    while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+        switch (opt) {
+            case 'r':
+                readPercent = atoi(optarg);
+                break;
+            case 's':
+                shards = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r read_percent] [-s shards] [max_threads]\n", argv[0]);
+                return 1;
+        }
+    }
+    int maxThreads = optind < argc ? atoi(argv[optind]) : (int)thread::hardware_concurrency();
+    unsigned seed = 0;
+
+    for (int i = 0; i < SEED; i++) {
+        keys.push_back(randomSlice(seed, MAX_KEY_LEN));
+        values.push_back(randomSlice(seed, MAX_VALUE_LEN));
+    }
+
+    if (shards > 0) {
+        shardedKvStore kv(SEED, shards);
+        scale(kv, maxThreads);
+    } else {
+        kvStore kv(SEED);
+        scale(kv, maxThreads);
+    }
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <bits/stdc++.h>
+#include <unistd.h>
+#include "histogram.hpp"
+#include "kvStore.cpp"
+#include "trace.hpp"
+
+using namespace std;
+
+// Replays a trace (see trace.hpp) against a kvStore from the mapped file
+// and prints throughput, hits and latency percentiles (ns) per operation
+// type as CSV.
+//
+//   replay [-t threads] [-w warmup] trace
+//
+// The first warmup records (say the generator's seed inserts) are applied
+// unmeasured on one thread. The rest run in order on one thread, or are cut
+// into equal contiguous parts replayed by a thread each: then the order
+// across parts is lost, so some lookups, erases and rank operations miss.
+
+static const char *opNames[TRACE_OP_TYPES] = {"lookup", "insert", "erase", "lookup_n", "erase_n"};
+
+struct Part {
+    const char *begin, *end;
+    LatencyHistogram latencies[TRACE_OP_TYPES];
+    uint64_t hits[TRACE_OP_TYPES] = {};
+};
+
+// returns whether the operation found its key (inserts: overwrote it)
+bool apply(kvStore &kv, const TraceOp &record) {
+    Slice key((char *) record.key, record.keySize), value, found;
+    switch (record.op) {
+        case LOOKUP_OP:
+            return kv.get(key, found);
+        case INSERT_OP:
+            value = Slice((char *) record.value, record.valueSize);
+            return kv.put(key, value);
+        case ERASE_OP:
+            return kv.del(key);
+        case LOOKUPN_OP:
+            if (!kv.get((int) record.N - 1, key, found))
+                return false;
+            free(key.data);
+            return true;
+        case ERASEN_OP:
+            return kv.del((int) record.N - 1);
+        default:
+            return false;
+    }
+}
+
+void replay(kvStore &kv, Part &part) {
+    TraceOp record{};
+    for (const char *at = part.begin; at < part.end;) {
+        at = Trace::next(at, record);
+        uint64_t start = nowNs();
+        bool hit = apply(kv, record);
+        part.latencies[record.op].record(nowNs() - start);
+        part.hits[record.op] += hit;
+    }
+}
+
+int main(int argc, char **argv) {
+    int threads = 1;
+    uint64_t warmup = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:w:")) != -1) {
+        if (opt == 't') {
+            threads = max(atoi(optarg), 1);
+        } else if (opt == 'w') {
+            warmup = strtoull(optarg, nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-t threads] [-w warmup] trace\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-t threads] [-w warmup] trace\n", argv[0]);
+        return 1;
+    }
+
+    Trace trace;
+    if (!trace.open(argv[optind])) {
+        fprintf(stderr, "%s is not a readable trace\n", argv[optind]);
+        return 1;
+    }
+    uint64_t ops = trace.header().ops;
+    warmup = min(warmup, ops);
+    kvStore kv(trace.header().inserts);
+
+    TraceOp record{};
+    const char *at = trace.begin();
+    for (uint64_t i = 0; i < warmup; i++) {
+        at = Trace::next(at, record);
+        apply(kv, record);
+    }
+
+    // cut the rest at record boundaries, one pass over the headers
+    vector<Part> parts(threads);
+    uint64_t measured = ops - warmup;
+    for (int t = 0; t < threads; t++) {
+        parts[t].begin = at;
+        uint64_t count = measured * (t + 1) / threads - measured * t / threads;
+        for (uint64_t i = 0; i < count; i++)
+            at = Trace::next(at, record);
+        parts[t].end = at;
+    }
+
+    uint64_t start = nowNs();
+    vector<thread> workers;
+    for (auto &part : parts)
+        workers.emplace_back([&kv, &part] { replay(kv, part); });
+    for (auto &w : workers)
+        w.join();
+    double seconds = (nowNs() - start) / 1e9;
+
+    printf("threads,op,count,hits,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+    LatencyHistogram all;
+    uint64_t allHits = 0;
+    auto print = [&](const char *name, const LatencyHistogram &h, uint64_t hits) {
+        printf("%d,%s,%lu,%lu,%.0lf,%lu,%lu,%lu,%lu\n", threads, name, h.count(), hits, h.count() / seconds,
+               h.percentile(0.5), h.percentile(0.99), h.percentile(0.999), h.max());
+    };
+    for (int op = 0; op < TRACE_OP_TYPES; op++) {
+        LatencyHistogram merged;
+        uint64_t hits = 0;
+        for (auto &part : parts) {
+            merged.add(part.latencies[op]);
+            hits += part.hits[op];
+        }
+        if (merged.count())
+            print(opNames[op], merged, hits);
+        all.add(merged);
+        allHits += hits;
+    }
+    print("all", all, allHits);
+    return 0;
+}
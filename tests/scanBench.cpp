@@ -0,0 +1,92 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// ordered export of the whole store and "list keys under a prefix", once
+// through get(N) and once through a cursor
+#define PREFIX_QUERIES 100000
+
+int main() {
+    unsigned seed = 0;
+    kvStore kv(SEED);
+    vector<string> keys = randomKeys(seed, SEED);
+    preload(kv, keys);
+
+    struct timespec st, en;
+    long bytes = 0;
+    printf("job,method,seconds,entries\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    int n = 0;
+    Slice key, val;
+    while (kv.get(n, key, val)) {
+        bytes += key.size + val.size;
+        free(key.data);
+        n++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("export,getN,%.3lf,%d\n", timer(en) - timer(st), n);
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    char buffer[256];
+    n = 0;
+    {
+        kvStore::Cursor cursor(kv, buffer);
+        for (bool ok = cursor.seek(0); ok; ok = cursor.next()) {
+            bytes += cursor.key().size + cursor.value().size;
+            n++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("export,cursor,%.3lf,%d\n", timer(en) - timer(st), n);
+    int entries = n;
+
+    // 3-character prefixes match ~7 keys each; get(N) first needs the rank
+    // of the prefix, found here by binary search over get(N)
+    vector<string> prefixes;
+    while (prefixes.size() < PREFIX_QUERIES) {
+        string &k = keys[rand_r(&seed) % keys.size()];
+        if (k.size() >= 3)
+            prefixes.push_back(k.substr(0, 3));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    n = 0;
+    for (auto &p : prefixes) {
+        int lo = 0, hi = entries;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            kv.get(mid, key, val);
+            if (string(key.data, key.size) < p)
+                lo = mid + 1;
+            else
+                hi = mid;
+            free(key.data);
+        }
+        while (kv.get(lo, key, val)) {
+            bool match = key.size >= p.size() && !memcmp(key.data, p.data(), p.size());
+            free(key.data);
+            if (!match)
+                break;
+            lo++;
+            n++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("prefix,getN,%.3lf,%d\n", timer(en) - timer(st), n);
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    n = 0;
+    for (auto &p : prefixes) {
+        kvStore::Cursor cursor(kv, buffer);
+        for (bool ok = cursor.prefixScan(Slice(&p[0], p.size())); ok; ok = cursor.next())
+            n++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("prefix,cursor,%.3lf,%d\n", timer(en) - timer(st), n);
+
+    return bytes == 0;
+}
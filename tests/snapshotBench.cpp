@@ -0,0 +1,78 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// restart cost: rebuilding a store by putting every key again against
+// mapping a snapshot, then what the first lookups and the first write
+// (which copies the snapshot into the trie) cost after that
+#define LOOKUPS 1000000
+#define SNAPSHOT_PATH "snapshotBench.snap"
+
+int main() {
+    unsigned seed = 0;
+    vector<string> keys = randomKeys(seed, SEED);
+    Slice v = benchValue();
+
+    struct timespec st, en;
+    printf("step,seconds\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    {
+        kvStore kv(SEED);
+        preload(kv, keys);
+        clock_gettime(CLOCK_MONOTONIC, &en);
+        printf("rebuild_by_put,%.3lf\n", timer(en) - timer(st));
+
+        clock_gettime(CLOCK_MONOTONIC, &st);
+        if (!kv.saveSnapshot(SNAPSHOT_PATH)) {
+            perror(SNAPSHOT_PATH);
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &en);
+        printf("save,%.3lf\n", timer(en) - timer(st));
+    }
+
+    kvStore kv(SEED);
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    if (!kv.loadSnapshot(SNAPSHOT_PATH))
+        return 1;
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("load,%.6lf\n", timer(en) - timer(st));
+
+    Slice val;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    Slice first(&keys[0][0], keys[0].size());
+    bool found = kv.get(first, val);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("first_get,%.6lf\n", timer(en) - timer(st));
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    long hits = found;
+    for (int i = 0; i < LOOKUPS; i++) {
+        string &k = keys[rand_r(&seed) % keys.size()];
+        Slice key(&k[0], k.size());
+        hits += kv.get(key, val);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("gets_from_snapshot,%.3lf\n", timer(en) - timer(st));
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    kv.put(first, v);
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("first_put_hydrates,%.3lf\n", timer(en) - timer(st));
+
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int i = 0; i < LOOKUPS; i++) {
+        string &k = keys[rand_r(&seed) % keys.size()];
+        Slice key(&k[0], k.size());
+        hits += kv.get(key, val);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("gets_after_hydration,%.3lf\n", timer(en) - timer(st));
+
+    remove(SNAPSHOT_PATH);
+    return hits != 2 * LOOKUPS + 1;
+}
@@ -0,0 +1,68 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// kvStore::stats() after loading SEED keys, overwriting and deleting a
+// quarter of them, and freezing, with the cost of a poll (counters only)
+// and of a full walk. tester checks that the walk agrees with the counters.
+#define POLLS 100000
+#define WALKS 5
+
+void report(const char *phase, kvStore &kv) {
+    StoreStats s = kv.stats(true);
+    const TrieStats &t = s.trie;
+    double depth = 0;
+    for (size_t d = 0; d < t.depths.size(); d++)
+        depth += (double) d * t.depths[d];
+    printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.2lf,%.2lf,%.2lf,%.1lf,%.1lf,%.1lf,%.1lf\n", phase, s.entries, t.nodes,
+           t.containers[0], t.containers[1], t.containers[2], t.containers[3], t.retired, t.averageLabel(),
+           t.entries ? depth / t.entries : 0, t.containerFill(), t.liveLogBytes / 1e6, t.garbageLogBytes / 1e6,
+           s.bytes() / 1e6, s.entries ? (double) s.bytes() / s.entries : 0);
+}
+
+int main() {
+    unsigned seed = 0;
+    vector<string> keys = randomKeys(seed, SEED);
+    Slice v = benchValue();
+    kvStore kv(SEED);
+
+    printf("phase,entries,nodes,node4,node16,node48,node256,retired,avg_label,avg_depth,container_fill,"
+           "live_log_mb,garbage_log_mb,mb,bytes_per_key\n");
+    preload(kv, keys);
+    report("loaded", kv);
+
+    for (int i = 0; i < SEED / 4; i++) {
+        Slice key(&keys[i][0], keys[i].size());
+        kv.put(key, v);
+    }
+    report("overwritten", kv);
+
+    for (int i = SEED / 4; i < SEED / 2; i++) {
+        Slice key(&keys[i][0], keys[i].size());
+        kv.del(key);
+    }
+    report("deleted", kv);
+
+    struct timespec st, en;
+    uint64_t seen = 0;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int i = 0; i < POLLS; i++)
+        seen += kv.stats().entries;
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    double pollNs = (timer(en) - timer(st)) * 1e9 / POLLS;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    for (int i = 0; i < WALKS; i++)
+        seen += kv.stats(true).entries;
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    double walkMs = (timer(en) - timer(st)) * 1e3 / WALKS;
+
+    kv.freeze();
+    // the trie is empty, the frozen one and the replaced arena hold it all
+    report("frozen", kv);
+
+    printf("poll_ns,%.0lf\nwalk_ms,%.1lf\n", pollNs, walkMs);
+    return seen == 0;
+}
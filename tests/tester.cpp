@@ -1,4 +1,3 @@
-#include <fstream>
 #include <map>
 
 #include <iostream>
@@ -6,14 +5,14 @@
 #include <string.h>
 #include <vector>
 #include <cassert>
-#include "fast_map.hpp"
+#include <random>
+#include <set>
+#include <sys/wait.h>
+#include "kvStore.cpp"
+#include "shardedKvStore.cpp"
+#include "trace.hpp"
 
 using namespace std;
-#define LOOKUP_OP 0
-#define INSERT_OP 1
-#define ERASE_OP 2
-#define LOOKUPN_OP 3
-#define ERASEN_OP 4
 #define contSize(x) (int) x.size()
 
 map<string, string> naive;
@@ -68,34 +67,106 @@ map<string, string>::iterator getNth(int n) {
     return iterator;
 }
 
+// the entries the trace inserts before its first other operation, which
+// the checks after the replay build stores from
+map<string, string> seeded;
+
+// naive's entries without the empty ones its lookups leave
+map<string, string> live() {
+    map<string, string> entries;
+    for (auto &e : naive)
+        if (!e.second.empty())
+            entries.insert(e);
+    return entries;
+}
+
 #define fail(x)                                                              \
     {                                                                        \
         printf("Mismatch at operation %d, optype %d, index %d\n", i, op, x); \
-        return;                                                              \
+        exit(1);                                                             \
     }
 
-void fileCheck() {
-    const char *FILE_PATH = "../tests/genInp.txt";
+// exits with 1 unless cond holds
+#define check(cond, what)                                  \
+    if (!(cond)) {                                         \
+        printf("%s: %s check failed\n", phase, what);      \
+        exit(1);                                           \
+    }
+
+// the walk reached every counted node, key, container and label character
+void consistent(const TrieStats &t, uint64_t roots, const char *phase) {
+    uint64_t nodes = 0, children = 0, keys = 0;
+    for (size_t c = 0; c < t.fanouts.size(); c++) {
+        nodes += t.fanouts[c];
+        children += c * t.fanouts[c];
+    }
+    for (auto d : t.depths)
+        keys += d;
+    check(nodes == t.nodes && children == t.nodes - roots, "stats nodes");
+    check(keys == t.entries && t.deadNodes == 0, "stats entries");
+    for (int c = 0; c < 4; c++)
+        check(t.walkedContainers[c] == t.containers[c], "stats containers");
+    check(t.walkedLabelChars == t.labelChars, "stats labelChars");
+}
+
+// a frozen kvStore counts its entries outside the trie
+void checkStats(kvStore &kv, uint64_t entries, const char *phase) {
+    StoreStats s = kv.stats(true);
+    check(s.entries == entries, "stats store entries");
+    consistent(s.trie, 1, phase);
+}
+
+// one trie per shard, 16 by default
+void checkStats(shardedKvStore &kv, uint64_t entries, const char *phase) {
+    TrieStats t = kv.stats(true);
+    check(t.entries == entries, "stats store entries");
+    consistent(t, 16, phase);
+}
 
-    ifstream file(FILE_PATH);
+// Replays a trace written by generator.cpp against a store and std::map.
+// prefixCache turns on the store's prefix cache once the trace's initial
+// inserts are in, so it is built over a filled trie and then kept up.
+template <typename Store>
+void fileCheck(const char *path, bool prefixCache = false) {
+    Trace trace;
+    if (!trace.open(path)) {
+        printf("Couldn't read trace %s\n", path);
+        exit(2);
+    }
 
-    int opCount;
-    file >> opCount;
+    int opCount = trace.header().ops;
     std::cout << opCount << endl;
 
-    kvStore fastMap((uint64_t)opCount);
+    naive.clear();
+    Store fastMap(trace.header().inserts);
 
+    const char *at = trace.begin();
     for (int i = 1; i <= opCount; i++) {
-        int op;
-        file >> op;
-        string key;
+        TraceOp record{};
+        at = Trace::next(at, record);
+        int op = record.op;
+        if (op != INSERT_OP && seeded.empty())
+            seeded = live();
+        if (op != INSERT_OP && prefixCache) {
+            fastMap.enablePrefixCache();
+            prefixCache = false;
+        }
+        string key(record.key, record.keySize);
+#ifdef PACKED_LABELS
+        // packed labels can't tell apart bytes outside their alphabet
+        for (char c : key) {
+            if (!labelCodes.code[(uint8_t) c]) {
+                printf("Key at operation %d isn't made of digits, letters and '_'\n", i);
+                exit(2);
+            }
+        }
+#endif
         string actual, value;
         int found, wasFound, actuallyFound, isOverwrite, nth;
         Slice x, y, z;
 
         switch (op) {
             case LOOKUP_OP:
-                file >> key;
                 actual = naive[key];
                 actuallyFound = actual.size() > 0;
 
@@ -122,8 +193,7 @@ void fileCheck() {
 
                 break;
             case INSERT_OP:
-                file >> key;
-                file >> value;
+                value.assign(record.value, record.valueSize);
 
                 isOverwrite = (naive[key].size() > 0);
                 naive[key] = value;
@@ -159,7 +229,6 @@ void fileCheck() {
 
                 break;
             case ERASE_OP:
-                file >> key;
                 it = naive.find(key);
                 found = it != naive.end() && (*it).second.size() > 0;
                 if (found)
@@ -184,7 +253,7 @@ void fileCheck() {
 
                 break;
             case LOOKUPN_OP:
-                file >> nth;
+                nth = record.N;
                 wasFound = true;
 
                 if (nth > contSize(naive)) {
@@ -194,7 +263,8 @@ void fileCheck() {
                     value = (*it).second;
                 }
 
-                found = fastMap.get(nth, x, y);
+                // traces count N from one, kvStore from zero
+                found = fastMap.get(nth - 1, x, y);
 
                 if (found != wasFound) {
                     fail(0);
@@ -213,7 +283,7 @@ void fileCheck() {
 
                 break;
             case ERASEN_OP:
-                file >> nth;
+                nth = record.N;
                 wasFound = true;
                 if (nth > contSize(naive)) {
                     wasFound = false;
@@ -224,7 +294,7 @@ void fileCheck() {
                     naive.erase(it);
                 }
 
-                found = fastMap.del(nth);
+                found = fastMap.del(nth - 1);
 
                 if (found != wasFound) {
                     fail(0);
@@ -254,13 +324,421 @@ void fileCheck() {
                 printf("Completed op %d\n", i);
     }
 
+    if (seeded.empty())
+        seeded = live();
+    checkStats(fastMap, live().size(), "replay");
+
     // remove all unremoved values from map
     //while (fastMap.del(1))
      //   ;
 }
 
-int main() {
-    fileCheck();
+#define BATCH_ROUNDS 3000
+#define MAX_BATCH 64
+
+// The checks below build fresh stores from the seeded entries and compare
+// them with the map by key, by rank and in key order.
+
+string str(const Slice &s) {
+    return string(s.data, s.size);
+}
+
+Slice slice(const string &s) {
+    return Slice((char *) s.data(), s.size());
+}
+
+template <typename Store>
+void putAll(Store &kv, const map<string, string> &entries) {
+    for (auto &e : entries) {
+        Slice key = slice(e.first), value = slice(e.second);
+        kv.put(key, value);
+    }
+}
+
+template <typename Store>
+void sameEntries(Store &kv, const map<string, string> &expected, const char *phase) {
+    Slice key, value;
+    for (auto &e : expected) {
+        key = slice(e.first);
+        check(kv.get(key, value) && str(value) == e.second, "get");
+    }
+
+    int n = 0;
+    for (auto &e : expected) {
+        check(kv.get(n++, key, value) && str(key) == e.first && str(value) == e.second, "get(N)");
+        free(key.data);
+    }
+    check(!kv.get(n, key, value), "get(N) past the last key");
+
+    char buffer[256];
+    typename Store::Cursor cursor(kv, buffer);
+    auto it = expected.begin();
+    for (bool ok = cursor.seek(Slice(buffer, 0)); ok; ok = cursor.next(), it++)
+        check(it != expected.end() && str(cursor.key()) == it->first && str(cursor.value()) == it->second,
+              "cursor order");
+    check(it == expected.end(), "cursor end");
+}
+
+// seek(key) lands on the first key >= key, seek(N) on the N-th and
+// prefixScan stops after the last key with the prefix
+template <typename Store>
+void checkCursor(const map<string, string> &expected, const char *phase) {
+    Store kv(expected.size());
+    putAll(kv, expected);
+    sameEntries(kv, expected, phase);
+
+    char buffer[256];
+    typename Store::Cursor cursor(kv, buffer);
+    int n = 0;
+    for (auto &e : expected) {
+        if (n++ % 7)
+            continue;
+        string shorter = e.first.substr(0, e.first.size() - 1), after = e.first, longer = e.first + "a";
+        // stays a letter, for testerPacked
+        if (isalpha(after.back() + 1))
+            after.back()++;
+        for (const string &probe : {e.first, shorter, after, longer}) {
+            auto it = expected.lower_bound(probe);
+            bool ok = cursor.seek(slice(probe));
+            for (int step = 0; step < 3; step++, it++, ok = cursor.next()) {
+                check(ok == (it != expected.end()), "seek(key)");
+                if (!ok)
+                    break;
+                check(str(cursor.key()) == it->first && str(cursor.value()) == it->second, "seek(key)");
+            }
+        }
+
+        check(cursor.seek(n - 1) && str(cursor.key()) == e.first, "seek(N)");
+
+        for (size_t len = 1; len <= 2 && len <= e.first.size(); len++) {
+            string prefix = e.first.substr(0, len);
+            auto it = expected.lower_bound(prefix);
+            for (bool ok = cursor.prefixScan(slice(prefix)); ok; ok = cursor.next(), it++)
+                check(it != expected.end() && str(cursor.key()) == it->first, "prefixScan");
+            check(it == expected.end() || it->first.compare(0, len, prefix), "prefixScan end");
+        }
+    }
+    check(!cursor.seek((int) expected.size()), "seek(N) past the last key");
+}
+
+// a store mapped by loadSnapshot answers like the one saved, and keeps
+// doing so once a write copies the snapshot into its trie
+void checkSnapshot(map<string, string> expected, const char *phase) {
+    const char *path = "tester.snap", *again = "tester.snap2";
+    {
+        kvStore kv(expected.size());
+        putAll(kv, expected);
+        check(kv.saveSnapshot(path), "saveSnapshot");
+    }
+    {
+        kvStore kv(expected.size());
+        check(kv.loadSnapshot(path), "loadSnapshot");
+        check(kv.saveSnapshot(again), "saveSnapshot of a loaded store");
+    }
+
+    kvStore kv(expected.size());
+    check(kv.loadSnapshot(again), "loadSnapshot");
+    check(!kv.loadSnapshot(again), "loadSnapshot into a loaded store");
+    sameEntries(kv, expected, phase);
+
+    string key = "snapshotWrite", value = "written";
+    Slice k = slice(key), v = slice(value);
+    kv.put(k, v);
+    expected[key] = value;
+    if (expected.size() > 1) {
+        k = slice(expected.begin()->first);
+        check(kv.del(k), "del after loadSnapshot");
+        expected.erase(expected.begin());
+    }
+    sameEntries(kv, expected, phase);
+    unlink(path);
+    unlink(again);
+}
+
+// A child process logs puts and dels, with a checkpoint halfway, and dies
+// without closing its store; a torn record is then appended to its log.
+// Recovery from the checkpoint and the log gives what the child wrote, and
+// writes after it survive the next reopen.
+void checkWal(const map<string, string> &seed, const char *phase) {
+    const char *walPath = "tester.wal", *snapshotPath = "tester.walsnap";
+    unlink(walPath);
+    unlink(snapshotPath);
+
+    // the child overwrites the first key, and puts and deletes two more,
+    // one by key and one by rank
+    map<string, string> expected = seed;
+    string overwritten = "overwritten", byKey = "walDeleted", byRank = "walDeletedN";
+    if (!expected.empty())
+        expected.begin()->second = overwritten;
+    expected.erase(byKey);
+    expected.erase(byRank);
+    int rank = distance(expected.begin(), expected.lower_bound(byRank));
+
+    // or the child's exit may print what is buffered a second time
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        kvStore kv(seed.size());
+        if (!kv.enableWal(walPath, snapshotPath, SYNC_NONE))
+            _exit(2);
+        size_t n = 0;
+        for (auto &e : seed) {
+            Slice key = slice(e.first), value = slice(e.second);
+            kv.put(key, value);
+            if (++n == seed.size() / 2 && !kv.checkpoint())
+                _exit(2);
+        }
+        Slice key, value = slice(overwritten);
+        if (!seed.empty()) {
+            key = slice(seed.begin()->first);
+            kv.put(key, value);
+        }
+        key = slice(byKey);
+        kv.put(key, value);
+        kv.del(key);
+        key = slice(byRank);
+        kv.put(key, value);
+        kv.del(rank);
+        // no destructors, as if the process crashed
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "logging child");
+
+    // the header of a record whose write was cut short
+    const char torn[] = {0x12, 0x34, 0x56, 0x78, WAL_PUT, 8};
+    FILE *f = fopen(walPath, "ab");
+    check(f && fwrite(torn, 1, sizeof(torn), f) == sizeof(torn), "appending a torn record");
+    fclose(f);
+
+    string key = "afterRecovery";
+    {
+        kvStore kv(expected.size());
+        check(kv.enableWal(walPath, snapshotPath, SYNC_NONE), "enableWal");
+        sameEntries(kv, expected, phase);
+        Slice k = slice(key), v = slice(key);
+        kv.put(k, v);
+        expected[key] = key;
+    }
+    kvStore kv(expected.size());
+    check(kv.enableWal(walPath, snapshotPath, SYNC_NONE), "enableWal after recovery");
+    sameEntries(kv, expected, phase);
+    unlink(walPath);
+    unlink(snapshotPath);
+}
+
+// multiGet, multiPut and multiDel on random batches, every fourth key a
+// repeat of an earlier one in the same batch, report and leave what
+// applying the keys one at a time in batch order would
+template <typename Store>
+void checkBatches(map<string, string> expected, const char *phase) {
+    // the seeded keys and, mostly absent, each one extended by a letter
+    vector<string> pool;
+    for (auto &e : expected) {
+        pool.push_back(e.first);
+        pool.push_back(e.first + "b");
+    }
+    if (pool.empty())
+        pool.push_back("batch");
+
+    Store kv(expected.size());
+    putAll(kv, expected);
+    mt19937 rng(2);
+    for (int round = 0; round < BATCH_ROUNDS; round++) {
+        int n = rng() % MAX_BATCH + 1, op = rng() % 3;
+        string keyStrings[MAX_BATCH], valueStrings[MAX_BATCH];
+        Slice keys[MAX_BATCH], values[MAX_BATCH];
+        bool flags[MAX_BATCH];
+        for (int i = 0; i < n; i++) {
+            keyStrings[i] = i && rng() % 4 == 0 ? keyStrings[rng() % i] : pool[rng() % pool.size()];
+            valueStrings[i] = "batch" + to_string(round) + "n" + to_string(i);
+            keys[i] = slice(keyStrings[i]);
+            values[i] = slice(valueStrings[i]);
+        }
+
+        int hits = 0;
+        if (op == 0) {
+            int reported = kv.multiGet(keys, values, flags, n);
+            for (int i = 0; i < n; i++) {
+                auto it = expected.find(keyStrings[i]);
+                check(flags[i] == (it != expected.end()), "multiGet found");
+                check(!flags[i] || str(values[i]) == it->second, "multiGet value");
+                hits += flags[i];
+            }
+            check(reported == hits, "multiGet count");
+        } else if (op == 1) {
+            int reported = kv.multiPut(keys, values, flags, n);
+            for (int i = 0; i < n; i++) {
+                check(flags[i] == (expected.count(keyStrings[i]) > 0), "multiPut overwritten");
+                expected[keyStrings[i]] = valueStrings[i];
+                hits += flags[i];
+            }
+            check(reported == hits, "multiPut count");
+        } else {
+            int reported = kv.multiDel(keys, flags, n);
+            for (int i = 0; i < n; i++) {
+                check(flags[i] == (expected.erase(keyStrings[i]) > 0), "multiDel deleted");
+                hits += flags[i];
+            }
+            check(reported == hits, "multiDel count");
+        }
+    }
+    sameEntries(kv, expected, phase);
+}
+
+// getAsync answers present and absent keys like std::map, through
+// futures and through callbacks, with the key buffers gone by then
+template <typename Store>
+void checkAsync(const map<string, string> &expected, const char *phase) {
+    Store kv(expected.size());
+    putAll(kv, expected);
+
+    // every key and, mostly absent, each one extended by a letter
+    vector<string> probes;
+    for (auto &e : expected) {
+        probes.push_back(e.first);
+        probes.push_back(e.first + "b");
+    }
+
+    vector<future<GetResult>> futures;
+    vector<pair<bool, string>> called(probes.size());
+    atomic<size_t> answered(0);
+    for (size_t p = 0; p < probes.size(); p++) {
+        string key = probes[p];
+        futures.push_back(kv.getAsync(slice(key)));
+        kv.getAsync(slice(key), [&called, &answered, p](bool found, Slice value) {
+            called[p] = {found, found ? str(value) : string()};
+            answered.fetch_add(1, memory_order_release);
+        });
+        // submit copied the key
+        fill(key.begin(), key.end(), '.');
+    }
+
+    for (size_t p = 0; p < probes.size(); p++) {
+        auto it = expected.find(probes[p]);
+        GetResult r = futures[p].get();
+        check(r.found == (it != expected.end()), "getAsync future found");
+        check(!r.found || str(r.value) == it->second, "getAsync future value");
+    }
+    while (answered.load(memory_order_acquire) < probes.size())
+        this_thread::yield();
+    for (size_t p = 0; p < probes.size(); p++) {
+        auto it = expected.find(probes[p]);
+        check(called[p].first == (it != expected.end()), "getAsync callback found");
+        check(!called[p].first || called[p].second == it->second, "getAsync callback value");
+    }
+}
+
+// bulkLoad, sorted or not and on one thread or several, fills an empty
+// store with what putting the same entries in turn would; a key given
+// twice keeps its later value, and input passed as sorted that isn't
+// loses no keys
+template <typename Store>
+void checkBulkLoad(const map<string, string> &expected, const char *phase) {
+    string stale = "stale";
+    vector<pair<string, string>> sorted(expected.begin(), expected.end()), shuffled, repeated, swapped, reversed;
+    for (size_t i = 0; i < sorted.size(); i += 3)
+        repeated.emplace_back(sorted[i].first, stale);
+    shuffled = sorted;
+    mt19937 rng(1);
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+    shuffle(repeated.begin(), repeated.end(), rng);
+    repeated.insert(repeated.end(), shuffled.begin(), shuffled.end());
+    // one pair out of place halfway, and everything backwards
+    swapped = sorted;
+    if (swapped.size() > 1)
+        swap(swapped[swapped.size() / 2 - 1], swapped[swapped.size() / 2]);
+    reversed.assign(sorted.rbegin(), sorted.rend());
+
+    for (int threads : {1, 4}) {
+        for (bool prefixCache : {false, true}) {
+            for (auto *entries : {&sorted, &swapped, &reversed, &repeated}) {
+                bool claimSorted = entries != &repeated;
+                vector<Slice> keys, values;
+                for (auto &e : *entries) {
+                    keys.push_back(slice(e.first));
+                    values.push_back(slice(e.second));
+                }
+                Store kv(expected.size());
+                // enabled while empty, so the load has to fill the cache
+                if (prefixCache)
+                    kv.enablePrefixCache();
+                check(kv.bulkLoad(keys.data(), values.data(), keys.size(), claimSorted, threads), "bulkLoad");
+                sameEntries(kv, expected, phase);
+                check(!kv.bulkLoad(keys.data(), values.data(), keys.size(), claimSorted, threads),
+                      "bulkLoad into a filled store");
+            }
+        }
+    }
+}
+
+// a frozen store answers gets, ranks and prefix scans like the trie it
+// replaced, and the first write after freeze() brings the trie back
+void checkFreeze(map<string, string> expected, const char *phase) {
+    kvStore kv(expected.size());
+    putAll(kv, expected);
+    kv.freeze();
+    checkStats(kv, expected.size(), phase);
+    // the cursor at the end rebuilds the trie
+    sameEntries(kv, expected, phase);
+    checkStats(kv, expected.size(), phase);
+
+    kv.freeze();
+    kv.freeze();
+    set<string> prefixes;
+    for (auto &e : expected)
+        prefixes.insert(e.first.substr(0, 1));
+    for (auto &prefix : prefixes) {
+        auto it = expected.lower_bound(prefix);
+        kv.prefixScan(slice(prefix), [&](const Slice &key, const Slice &value) {
+            check(it != expected.end() && str(key) == it->first && str(value) == it->second, "prefixScan");
+            it++;
+        });
+        check(it == expected.end() || it->first.compare(0, 1, prefix), "prefixScan end");
+    }
+
+    string key = "freezeWrite";
+    Slice k = slice(key), v = slice(key);
+    kv.put(k, v);
+    expected[key] = key;
+    if (expected.size() > 1) {
+        k = slice(expected.begin()->first);
+        check(kv.del(k), "del after freeze");
+        expected.erase(expected.begin());
+    }
+    sameEntries(kv, expected, phase);
+    checkStats(kv, expected.size(), phase);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "../tests/genInp.trace";
+    fileCheck<kvStore>(path);
     printf("File check done\n");
+    fileCheck<shardedKvStore>(path);
+    printf("Sharded file check done\n");
+    fileCheck<kvStore>(path, true);
+    printf("Prefix cache file check done\n");
+    fileCheck<shardedKvStore>(path, true);
+    printf("Sharded prefix cache file check done\n");
+
+    checkCursor<kvStore>(seeded, "cursor");
+    checkCursor<shardedKvStore>(seeded, "sharded cursor");
+    printf("Cursor check done\n");
+    checkSnapshot(seeded, "snapshot");
+    printf("Snapshot check done\n");
+    checkWal(seeded, "wal");
+    printf("WAL check done\n");
+    checkBatches<kvStore>(seeded, "batch");
+    checkBatches<shardedKvStore>(seeded, "sharded batch");
+    printf("Batch check done\n");
+    checkAsync<kvStore>(seeded, "async");
+    checkAsync<shardedKvStore>(seeded, "sharded async");
+    printf("Async check done\n");
+    checkBulkLoad<kvStore>(seeded, "bulkLoad");
+    checkBulkLoad<shardedKvStore>(seeded, "sharded bulkLoad");
+    printf("Bulk load check done\n");
+    checkFreeze(seeded, "freeze");
+    printf("Freeze check done\n");
     return 0;
 }
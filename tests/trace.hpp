@@ -0,0 +1,159 @@
+#ifndef trace_h
+#define trace_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary operation traces, written by tests/generator.cpp (or converted
+// from captured traffic) and read by tests/tester.cpp and tests/replay.cpp.
+//
+// A TraceHeader is followed by ops records. Each record starts with its
+// op byte:
+//   LOOKUP_OP, ERASE_OP   key size (1 byte), key
+//   INSERT_OP             key size, value size (1 byte each), key, value
+//   LOOKUPN_OP, ERASEN_OP N (4 bytes, little endian, one-indexed)
+#define LOOKUP_OP 0
+#define INSERT_OP 1
+#define ERASE_OP 2
+#define LOOKUPN_OP 3
+#define ERASEN_OP 4
+#define TRACE_OP_TYPES 5
+
+static const char traceMagic[8] = {'F', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
+
+struct TraceHeader {
+    char magic[8];
+    uint64_t ops;
+    // INSERT_OP records, an upper bound on the keys live at once
+    uint64_t inserts;
+};
+
+struct TraceOp {
+    int op;
+    const char *key, *value;
+    int keySize, valueSize;
+    uint32_t N;
+};
+
+// Appends records to a file, filling in the header on close.
+class TraceWriter {
+    FILE *file;
+    TraceHeader header;
+
+    void bytes(const void *data, size_t size) {
+        fwrite(data, 1, size, file);
+    }
+
+public:
+    TraceWriter() : file(nullptr), header() {}
+
+    bool open(const char *path) {
+        file = fopen(path, "wb");
+        if (!file)
+            return false;
+        setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        memcpy(header.magic, traceMagic, sizeof(traceMagic));
+        bytes(&header, sizeof(header));
+        return true;
+    }
+
+    // keys and values up to 255 bytes
+    void keyed(int op, const char *key, int keySize, const char *value = nullptr, int valueSize = 0) {
+        uint8_t sizes[3] = {(uint8_t) op, (uint8_t) keySize, (uint8_t) valueSize};
+        bytes(sizes, op == INSERT_OP ? 3 : 2);
+        bytes(key, keySize);
+        if (op == INSERT_OP)
+            bytes(value, valueSize);
+        header.ops++;
+        header.inserts += op == INSERT_OP;
+    }
+
+    void ranked(int op, uint32_t N) {
+        uint8_t record[5] = {(uint8_t) op, (uint8_t) N, (uint8_t) (N >> 8), (uint8_t) (N >> 16), (uint8_t) (N >> 24)};
+        bytes(record, sizeof(record));
+        header.ops++;
+    }
+
+    // false on I/O errors
+    bool close() {
+        bool ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+        return fclose(file) == 0 && ok;
+    }
+};
+
+// A trace mapped read-only; records are decoded in place, so keys and
+// values point into the mapping.
+class Trace {
+    const char *base;
+    size_t bytes;
+
+public:
+    Trace() : base(nullptr), bytes(0) {}
+
+    ~Trace() {
+        if (base)
+            munmap((void *) base, bytes);
+    }
+
+    Trace(const Trace &) = delete;
+
+    Trace &operator=(const Trace &) = delete;
+
+    // false if path can't be mapped or isn't a trace
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        void *mem = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(TraceHeader))
+            mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED)
+            return false;
+        base = (const char *) mem;
+        bytes = st.st_size;
+        // read front to back, once
+        madvise(mem, bytes, MADV_SEQUENTIAL);
+        if (memcmp(header().magic, traceMagic, sizeof(traceMagic))) {
+            munmap(mem, bytes);
+            base = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    const TraceHeader &header() const {
+        return *(const TraceHeader *) base;
+    }
+
+    const char *begin() const {
+        return base + sizeof(TraceHeader);
+    }
+
+    const char *end() const {
+        return base + bytes;
+    }
+
+    // decodes the record at at into op, returns where the next one starts
+    static const char *next(const char *at, TraceOp &op) {
+        op.op = (uint8_t) *at++;
+        if (op.op == LOOKUPN_OP || op.op == ERASEN_OP) {
+            const uint8_t *n = (const uint8_t *) at;
+            op.N = n[0] | n[1] << 8 | n[2] << 16 | (uint32_t) n[3] << 24;
+            return at + 4;
+        }
+        op.keySize = (uint8_t) *at++;
+        op.valueSize = op.op == INSERT_OP ? (uint8_t) *at++ : 0;
+        op.key = at;
+        op.value = at + op.keySize;
+        return at + op.keySize + op.valueSize;
+    }
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include <bits/stdc++.h>
+#include <time.h>
+#include "kvStore.cpp"
+#include "workload.hpp"
+
+using namespace std;
+
+// put throughput without a write-ahead log and under each SyncPolicy, from
+// one writer and from several sharing group commits, then how long replaying
+// the log takes on restart
+#define OPS 200000
+// SYNC_BATCH waits for the disk on every put, so it gets fewer
+#define BATCH_OPS 20000
+#define MAX_WRITERS 8
+#define WAL_PATH "walBench.wal"
+#define SNAPSHOT_PATH "walBench.snap"
+
+vector<string> keys;
+
+// puts ops keys from writers threads, returns ops/s
+double run(kvStore &kv, int ops, int writers) {
+    struct timespec st, en;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    vector<thread> threads;
+    for (int w = 0; w < writers; w++) {
+        threads.emplace_back([&, w] {
+            Slice v = benchValue();
+            for (int i = w; i < ops; i += writers) {
+                Slice key(&keys[i][0], keys[i].size());
+                kv.put(key, v);
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    return ops / (timer(en) - timer(st));
+}
+
+int main() {
+    unsigned seed = 0;
+    keys = randomKeys(seed, OPS);
+
+    const char *names[] = {"none", "interval", "batch"};
+    printf("policy,writers,ops_s\n");
+    for (int writers = 1; writers <= MAX_WRITERS; writers *= MAX_WRITERS) {
+        {
+            kvStore kv(OPS);
+            printf("off,%d,%.0lf\n", writers, run(kv, OPS, writers));
+        }
+        for (int policy = SYNC_NONE; policy <= SYNC_BATCH; policy++) {
+            remove(WAL_PATH);
+            remove(SNAPSHOT_PATH);
+            kvStore kv(OPS);
+            if (!kv.enableWal(WAL_PATH, SNAPSHOT_PATH, (SyncPolicy) policy)) {
+                perror(WAL_PATH);
+                return 1;
+            }
+            int ops = policy == SYNC_BATCH ? BATCH_OPS : OPS;
+            printf("%s,%d,%.0lf\n", names[policy], writers, run(kv, ops, writers));
+        }
+    }
+
+    // the last run left BATCH_OPS puts in the log
+    struct timespec st, en;
+    clock_gettime(CLOCK_MONOTONIC, &st);
+    {
+        kvStore kv(OPS);
+        kv.enableWal(WAL_PATH, SNAPSHOT_PATH, SYNC_NONE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &en);
+    printf("replay,1,%.0lf\n", BATCH_OPS / (timer(en) - timer(st)));
+
+    remove(WAL_PATH);
+    remove(SNAPSHOT_PATH);
+    return 0;
+}
@@ -0,0 +1,171 @@
+#ifndef workload_h
+#define workload_h
+
+#include "ctrie.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+// Key and request generators shared by the benchmarks.
+
+// keys the random-key benchmarks load up front, the longest random key and
+// the length of the stored values; define them before including this header
+// for other sizes
+#ifndef SEED
+#define SEED 1000000
+#endif
+#ifndef MAX_KEY_LEN
+#define MAX_KEY_LEN 64
+#endif
+#ifndef VALUE_LEN
+#define VALUE_LEN 16
+#endif
+
+// keys of generated records, letters only so every store option takes them
+#define WORKLOAD_KEY_LEN 10
+
+static const char alpha[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz";
+
+// seconds, for differences of clock_gettime readings
+inline double timer(struct timespec &t) {
+    return t.tv_nsec / 1e9 + t.tv_sec;
+}
+
+// n letters drawn with rand_r
+static inline void randomLetters(unsigned &seed, char *s, int n) {
+    for (int i = 0; i < n; i++)
+        s[i] = alpha[rand_r(&seed) % 52];
+}
+
+// a key of 1 to maxLen random letters
+static inline std::string randomKey(unsigned &seed, int maxLen) {
+    std::string k(rand_r(&seed) % maxLen + 1, ' ');
+    randomLetters(seed, &k[0], k.size());
+    return k;
+}
+
+// n keys of 1 to MAX_KEY_LEN random letters
+static inline std::vector<std::string> randomKeys(unsigned &seed, int n) {
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (int i = 0; i < n; i++)
+        keys.push_back(randomKey(seed, MAX_KEY_LEN));
+    return keys;
+}
+
+// A key of 1 to MAX_KEY_LEN letters that shares a random-length prefix with
+// one of keys, like tests/generator.cpp's PREFIX_OVERLAP mode, so the top of
+// the trie is several levels deep. Callers own the malloc'd data.
+static inline Slice overlappingKey(unsigned &seed, const std::vector<Slice> &keys) {
+    Slice s;
+    s.size = rand_r(&seed) % MAX_KEY_LEN + 1;
+    s.data = (char *) malloc(s.size);
+    int overlap = 0;
+    if (!keys.empty()) {
+        const Slice &other = keys[rand_r(&seed) % keys.size()];
+        overlap = rand_r(&seed) % std::min<int>(other.size, s.size);
+        memcpy(s.data, other.data, overlap);
+    }
+    randomLetters(seed, s.data + overlap, s.size - overlap);
+    return s;
+}
+
+// VALUE_LEN bytes of 'v', the value the benchmarks store
+static inline Slice benchValue() {
+    static std::string value(VALUE_LEN, 'v');
+    return Slice(&value[0], VALUE_LEN);
+}
+
+// puts every key with benchValue()
+template <typename Store>
+void preload(Store &kv, const std::vector<std::string> &keys) {
+    Slice v = benchValue();
+    for (auto &k : keys) {
+        Slice key((char *) k.data(), k.size());
+        kv.put(key, v);
+    }
+}
+
+// splitmix64's finalizer, a bijection on 64-bit words
+static inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Record id's key: WORKLOAD_KEY_LEN letters of a hash of id, so neighbouring
+// ids land all over the key space like YCSB's hashed user keys. 52^10 keys
+// leave collisions among a few hundred million ids unlikely.
+static inline void keyOf(uint64_t id, char *key) {
+    uint64_t h = mix64(id + 1);
+    for (int i = 0; i < WORKLOAD_KEY_LEN; i++) {
+        key[i] = alpha[h % 52];
+        h /= 52;
+    }
+}
+
+// splitmix64, one per thread
+class Rng {
+    uint64_t state;
+
+public:
+    explicit Rng(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        state += 0x9e3779b97f4a7c15ULL;
+        return mix64(state);
+    }
+
+    // in [0, n)
+    uint64_t below(uint64_t n) {
+        return next() % n;
+    }
+
+    // in [0, 1)
+    double uniform() {
+        return (next() >> 11) * (1.0 / (1ULL << 53));
+    }
+};
+
+// Zipfian ranks in [0, items), 0 the most popular, drawn in O(1) as in
+// Gray et al., "Quickly generating billion-record synthetic databases"
+// (what YCSB uses). Setting it up sums items terms once.
+class Zipfian {
+    uint64_t items;
+    double theta, alpha, zetan, eta;
+
+public:
+    explicit Zipfian(uint64_t items, double theta = 0.99) : items(items), theta(theta) {
+        zetan = 0;
+        for (uint64_t i = 1; i <= items; i++)
+            zetan += 1 / pow((double) i, theta);
+        double zeta2 = 1 + 1 / pow(2.0, theta);
+        alpha = 1 / (1 - theta);
+        eta = (1 - pow(2.0 / items, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    uint64_t next(Rng &rng) const {
+        double u = rng.uniform(), uz = u * zetan;
+        if (uz < 1)
+            return 0;
+        if (uz < 1 + pow(0.5, theta))
+            return 1;
+        uint64_t rank = (uint64_t) (items * pow(eta * u - eta + 1, alpha));
+        return rank < items ? rank : items - 1;
+    }
+
+    // a rank spread over [0, items) by hashing, so the popular records
+    // aren't neighbours in key order
+    uint64_t scrambled(Rng &rng) const {
+        return mix64(next(rng)) % items;
+    }
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include <bits/stdc++.h>
+#include <unistd.h>
+#include "histogram.hpp"
+#include "kvStore.cpp"
+
+using namespace std;
+
+// YCSB-style workloads against kvStore, each on a fresh store bulk loaded
+// with RECORDS records and run for OPS operations after WARMUP unmeasured
+// ones, split over every thread count given. Prints one CSV row per
+// workload, thread count and operation (and "all"): count, throughput and
+// latency percentiles in nanoseconds.
+//
+//   ycsbBench [-w workloads] [-d uniform|zipfian|latest] [-t 1,2,4]
+//             [-r records] [-o ops] [-W warmup]
+//
+// Workloads, with YCSB's default distributions (-d overrides them):
+//   A  50% read, 50% update                 zipfian
+//   B  95% read, 5% update                  zipfian
+//   C  100% read                            zipfian
+//   D  95% read, 5% insert                  latest
+//   E  95% scan of 1-MAX_SCAN keys, 5% insert zipfian
+//   F  50% read, 50% read-modify-write      zipfian
+//   R  95% get(N), 5% insert                uniform
+//   P  95% scan of a SCAN_PREFIX-letter prefix, 5% insert   zipfian
+#define RECORDS 1000000
+#define OPS 1000000
+#define WARMUP 100000
+#define VALUE_LEN 100
+#define MAX_SCAN 100
+#define SCAN_PREFIX 3
+#include "workload.hpp"
+
+enum Op { READ, UPDATE, INSERT, SCAN, RMW, RANK, PREFIX, OP_TYPES };
+static const char *opNames[OP_TYPES] = {"read", "update", "insert", "scan", "rmw", "rank", "prefix"};
+
+enum Distribution { UNIFORM, ZIPFIAN, LATEST };
+static const char *distributionNames[] = {"uniform", "zipfian", "latest"};
+
+struct Workload {
+    char name;
+    // share of each Op
+    double mix[OP_TYPES];
+    Distribution distribution;
+};
+
+static const Workload workloads[] = {
+    {'A', {0.5, 0.5, 0, 0, 0, 0, 0}, ZIPFIAN},
+    {'B', {0.95, 0.05, 0, 0, 0, 0, 0}, ZIPFIAN},
+    {'C', {1, 0, 0, 0, 0, 0, 0}, ZIPFIAN},
+    {'D', {0.95, 0, 0.05, 0, 0, 0, 0}, LATEST},
+    {'E', {0, 0, 0.05, 0.95, 0, 0, 0}, ZIPFIAN},
+    {'F', {0.5, 0, 0, 0, 0.5, 0, 0}, ZIPFIAN},
+    {'R', {0, 0, 0.05, 0, 0, 0.95, 0}, UNIFORM},
+    {'P', {0, 0, 0.05, 0, 0, 0, 0.95}, ZIPFIAN},
+};
+
+struct Run {
+    const Workload *workload;
+    Distribution distribution;
+    uint64_t records, ops, warmup;
+    int threads;
+};
+
+// one thread's share of a run
+class Client {
+    kvStore &kv;
+    const Run &run;
+    const Zipfian &zipf;
+    atomic<uint64_t> &inserted;
+    Rng rng;
+    char value[VALUE_LEN];
+
+public:
+    LatencyHistogram latencies[OP_TYPES];
+
+    Client(kvStore &kv, const Run &run, const Zipfian &zipf, atomic<uint64_t> &inserted, int id)
+        : kv(kv), run(run), zipf(zipf), inserted(inserted), rng(id + 1) {
+        for (auto &c : value)
+            c = alpha[rng.below(52)];
+    }
+
+    // an existing record to read or update
+    uint64_t pick() {
+        uint64_t last = inserted.load(memory_order_relaxed);
+        switch (run.distribution) {
+            case UNIFORM:
+                return rng.below(last);
+            case ZIPFIAN:
+                return zipf.scrambled(rng);
+            default: {
+                // the newest records are the most popular
+                uint64_t back = zipf.next(rng);
+                return back < last ? last - 1 - back : 0;
+            }
+        }
+    }
+
+    Op choose() {
+        double u = rng.uniform();
+        for (int op = 0; op < OP_TYPES - 1; op++) {
+            if (u < run.workload->mix[op])
+                return (Op) op;
+            u -= run.workload->mix[op];
+        }
+        return (Op) (OP_TYPES - 1);
+    }
+
+    void perform(Op op) {
+        char k[WORKLOAD_KEY_LEN];
+        Slice key(k, WORKLOAD_KEY_LEN), v(value, VALUE_LEN), found, foundKey;
+        keyOf(op == INSERT ? inserted.fetch_add(1) : pick(), k);
+        // a fresh value each time, so updates are real writes
+        value[rng.below(VALUE_LEN)] = alpha[rng.below(52)];
+
+        switch (op) {
+            case READ:
+                kv.get(key, found);
+                break;
+            case UPDATE:
+            case INSERT:
+                kv.put(key, v);
+                break;
+            case SCAN: {
+                char buffer[256];
+                int length = 1 + rng.below(MAX_SCAN);
+                kvStore::Cursor cursor(kv, buffer);
+                for (bool ok = cursor.seek(key); ok && --length > 0;)
+                    ok = cursor.next();
+                break;
+            }
+            case RMW:
+                if (kv.get(key, found))
+                    kv.put(key, v);
+                break;
+            case RANK:
+                if (kv.get(rng.below(inserted.load(memory_order_relaxed)), foundKey, found))
+                    free(foundKey.data);
+                break;
+            case PREFIX: {
+                long seen = 0;
+                kv.prefixScan(Slice(k, SCAN_PREFIX), [&seen](const Slice &, const Slice &) { seen++; });
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void work(uint64_t ops, bool measured) {
+        for (uint64_t i = 0; i < ops; i++) {
+            Op op = choose();
+            if (!measured) {
+                perform(op);
+                continue;
+            }
+            uint64_t start = nowNs();
+            perform(op);
+            latencies[op].record(nowNs() - start);
+        }
+    }
+};
+
+void print(const Run &run, const char *op, const LatencyHistogram &h, double seconds) {
+    printf("%c,%s,%d,%s,%lu,%.0lf,%lu,%lu,%lu,%lu\n", run.workload->name, distributionNames[run.distribution],
+           run.threads, op, h.count(), h.count() / seconds, h.percentile(0.5), h.percentile(0.99),
+           h.percentile(0.999), h.max());
+}
+
+void execute(const Run &run, const Zipfian &zipf) {
+    kvStore kv(run.records + run.ops + run.warmup);
+    {
+        vector<char> keys(run.records * WORKLOAD_KEY_LEN);
+        vector<Slice> k(run.records), v(run.records);
+        for (uint64_t i = 0; i < run.records; i++) {
+            keyOf(i, &keys[i * WORKLOAD_KEY_LEN]);
+            k[i] = Slice(&keys[i * WORKLOAD_KEY_LEN], WORKLOAD_KEY_LEN);
+            v[i] = benchValue();
+        }
+        kv.bulkLoad(k.data(), v.data(), run.records);
+    }
+
+    atomic<uint64_t> inserted(run.records);
+    vector<unique_ptr<Client>> clients;
+    for (int t = 0; t < run.threads; t++)
+        clients.emplace_back(new Client(kv, run, zipf, inserted, t));
+
+    // every thread warms up, then all start measuring together
+    atomic<int> warm(0);
+    uint64_t start = 0;
+    vector<thread> threads;
+    for (int t = 0; t < run.threads; t++) {
+        threads.emplace_back([&, t] {
+            clients[t]->work(run.warmup / run.threads, false);
+            warm++;
+            while (warm.load() < run.threads)
+                this_thread::yield();
+            clients[t]->work(run.ops / run.threads, true);
+        });
+    }
+    while (warm.load() < run.threads)
+        this_thread::yield();
+    start = nowNs();
+    for (auto &t : threads)
+        t.join();
+    double seconds = (nowNs() - start) / 1e9;
+
+    LatencyHistogram all;
+    for (int op = 0; op < OP_TYPES; op++) {
+        LatencyHistogram merged;
+        for (auto &c : clients)
+            merged.add(c->latencies[op]);
+        if (merged.count())
+            print(run, opNames[op], merged, seconds);
+        all.add(merged);
+    }
+    print(run, "all", all, seconds);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    string names = "ABCDEFRP", threadList = "1,2,4";
+    int distribution = -1;
+    uint64_t records = RECORDS, ops = OPS, warmup = WARMUP;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:d:t:r:o:W:")) != -1) {
+        switch (opt) {
+            case 'w':
+                names = optarg;
+                break;
+            case 'd':
+                for (int d = 0; d < 3; d++)
+                    if (!strcmp(optarg, distributionNames[d]))
+                        distribution = d;
+                if (distribution < 0) {
+                    fprintf(stderr, "unknown distribution %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                threadList = optarg;
+                break;
+            case 'r':
+                records = strtoull(optarg, nullptr, 10);
+                break;
+            case 'o':
+                ops = strtoull(optarg, nullptr, 10);
+                break;
+            case 'W':
+                warmup = strtoull(optarg, nullptr, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-w ABCDEFRP] [-d uniform|zipfian|latest] [-t 1,2,4] "
+                                "[-r records] [-o ops] [-W warmup]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (records == 0)
+        return 1;
+
+    vector<int> threadCounts;
+    for (char *t = strtok(&threadList[0], ","); t; t = strtok(nullptr, ","))
+        if (atoi(t) > 0)
+            threadCounts.push_back(atoi(t));
+
+    Zipfian zipf(records);
+    printf("workload,distribution,threads,op,count,ops_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+    for (char name : names) {
+        const Workload *w = nullptr;
+        for (auto &candidate : workloads)
+            if (candidate.name == toupper(name))
+                w = &candidate;
+        if (!w) {
+            fprintf(stderr, "unknown workload %c\n", name);
+            return 1;
+        }
+        for (int threads : threadCounts) {
+            Run run = {w, distribution < 0 ? w->distribution : (Distribution) distribution, records, ops, warmup,
+                       threads};
+            execute(run, zipf);
+        }
+    }
+    return 0;
+}